@@ -24,20 +24,26 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <functional>
 #include <iosfwd>
 #include <limits>
 #include <type_traits>
 #include <utility>
 
+#include "./kfp_int128.h"
+
 namespace kfp {
   // Check for prescence of __int128
-#ifdef __SIZEOF_INT128__
+  // Define KFP_PORTABLE_INT128 to use kfp::Int128 even if __int128 is
+  // available, or KFP_CUSTOM_INT128 to define kfp::int128_t and
+  // kfp::uint128_t yourself.
+#if defined(KFP_CUSTOM_INT128)
+#elif defined(__SIZEOF_INT128__) && !defined(KFP_PORTABLE_INT128)
   using int128_t = __int128_t;
   using uint128_t = __uint128_t;
 #else
-  // Use a library that provides a 128-bit int type with the usual operations
-  // and define kfp::int128_t and kfp::uint128_t to the signed/unsigned variant
-  // respectively if not done already.
+  using int128_t = Int128;
+  using uint128_t = UInt128;
 #endif
   template<typename T>
   struct DTI;
@@ -163,7 +169,9 @@ namespace kfp {
       return *this;
     }*/
     constexpr F& operator=(const I& i) noexcept {
-      underlying = i << d;
+      // Goes through the constructor so that this works when d is the
+      // width of I (e. g. frac32)
+      underlying = F(i).underlying;
       return *this;
     }
     template<typename I2, size_t d2>
@@ -337,11 +345,21 @@ namespace kfp {
   std::ostream& operator<<(std::ostream& fh, const Fixed<I, d>& x) {
     return fh << x.toDouble();
   }
+  // What to do when a result does not fit in the destination type
+  // (used by the batch functions in kfp_integrate.h and kfp_packed.h).
+  enum class Overflow {
+    wrap,
+    saturate,
+  };
   using s16_16 = Fixed<int32_t, 16>;
   using u16_16 = Fixed<uint32_t, 16>;
   using s2_30 = Fixed<int32_t, 30>;
   using s34_30 = Fixed<int64_t, 30>;
   using frac32 = Fixed<uint32_t, 32>;
+  // Narrow types for compact storage
+  using s8_8 = Fixed<int16_t, 8>;
+  using s2_14 = Fixed<int16_t, 14>;
+  using frac16 = Fixed<uint16_t, 16>;
   // User-defined literals
   template<typename I, size_t d>
   constexpr Fixed<I, d> convert(const char* s) {
@@ -359,13 +377,26 @@ namespace kfp {
     }
     F res(iPart);
     if (hasDecimal) {
-      u = t + 1;
-      F mult(1);
-      while (*u != '\0') {
-        mult /= 10;
-        res += mult * ((*u) - '0');
-        ++u;
+      // Compute the fractional part from the last digit backwards, with
+      // a few guard bits, and round it once at the end. This also works
+      // for types with no integral bits, where F(1) is 0.
+      constexpr size_t bits = d + 4 < 60 ? d + 4 : 60;
+      const char* end = t + 1;
+      while (*end != '\0') ++end;
+      uint64_t frac = 0;
+      for (u = end; u != t + 1;) {
+        --u;
+        frac = (frac + ((uint64_t) ((*u) - '0') << bits)) / 10;
+      }
+      if (bits >= d) {
+        frac = (frac + ((uint64_t) 1 << (bits - d) >> 1)) >> (bits - d);
+      } else {
+        frac <<= (d - bits);
       }
+      // A fractional part that rounds up to 1 carries into the integral
+      // part, or wraps around for types without integral bits.
+      using U = std::make_unsigned_t<I>;
+      res.underlying = (I) ((U) res.underlying + (U) frac);
     }
     return res;
   }
@@ -379,6 +410,9 @@ namespace kfp {
     DEFINE_OPERATOR_LITERAL(s2_30)
     DEFINE_OPERATOR_LITERAL(s34_30)
     DEFINE_OPERATOR_LITERAL(frac32)
+    DEFINE_OPERATOR_LITERAL(s8_8)
+    DEFINE_OPERATOR_LITERAL(s2_14)
+    DEFINE_OPERATOR_LITERAL(frac16)
   }
 #undef DEFINE_OPERATOR_LITERAL
 }
@@ -0,0 +1,154 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#ifndef KOZET_FIXED_POINT_KFP_CACHE_H
+#define KOZET_FIXED_POINT_KFP_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./kfp.h"
+#include "./kfp_extra.h"
+
+namespace kfp {
+  // Direct-mapped caches for the results of sincos() and rectp(), for
+  // workloads that compute the same values over and over (e. g. rings of
+  // bullets fired at fixed angles).
+  //
+  // A cache returns exactly what the uncached function would, so using one
+  // never changes the results of a simulation. Each cache has 2**logSize
+  // entries. Every entry starts out holding the result for zero inputs, so
+  // no validity flags are needed.
+  namespace cache_detail {
+    constexpr inline size_t index(uint32_t key, size_t logSize) noexcept {
+      // Fibonacci hashing, so that angles that are multiples of a large
+      // power of two are still spread out
+      return (size_t) ((uint32_t) (key * 0x9E3779B9u) >> (32 - logSize));
+    }
+    template<typename I>
+    constexpr uint32_t fold(I x) noexcept {
+      using U = std::make_unsigned_t<I>;
+      uint64_t u = (uint64_t) (U) x;
+      return (uint32_t) (u ^ (u >> 32));
+    }
+  }
+
+  template<size_t logSize = 8>
+  class SincosCache {
+  public:
+    static_assert(logSize >= 1 && logSize <= 24,
+      "logSize must be between 1 and 24");
+    SincosCache() noexcept { clear(); }
+    // Same as kfp::sincos(t, c, s).
+    void sincos(frac32 t, s2_30& c, s2_30& s) noexcept {
+      Entry& e = entries[cache_detail::index(t.underlying, logSize)];
+      if (e.key == t.underlying) {
+        ++nHits;
+      } else {
+        ++nMisses;
+        e.key = t.underlying;
+        kfp::sincos(t, e.c, e.s);
+      }
+      c = e.c;
+      s = e.s;
+    }
+    // Empties the cache and resets the statistics.
+    void clear() noexcept {
+      Entry zero;
+      zero.key = 0;
+      kfp::sincos(frac32(0), zero.c, zero.s);
+      for (Entry& e : entries) e = zero;
+      resetStatistics();
+    }
+    uint64_t hits() const noexcept { return nHits; }
+    uint64_t misses() const noexcept { return nMisses; }
+    void resetStatistics() noexcept { nHits = nMisses = 0; }
+    static constexpr size_t size() noexcept { return (size_t) 1 << logSize; }
+  private:
+    struct Entry {
+      uint32_t key;
+      s2_30 c, s;
+    };
+    Entry entries[(size_t) 1 << logSize];
+    uint64_t nHits, nMisses;
+  };
+
+  template<typename F, size_t logSize = 8>
+  class RectpCache {
+  public:
+    static_assert(logSize >= 1 && logSize <= 24,
+      "logSize must be between 1 and 24");
+    RectpCache() noexcept { clear(); }
+    // Same as kfp::rectp(c, s, r, t).
+    void rectp(F c, F s, F& r, frac32& t) noexcept {
+      uint32_t h = cache_detail::fold(c.underlying) * 0x85EBCA6Bu ^
+        cache_detail::fold(s.underlying);
+      Entry& e = entries[cache_detail::index(h, logSize)];
+      if (e.c == c && e.s == s) {
+        ++nHits;
+      } else {
+        ++nMisses;
+        e.c = c;
+        e.s = s;
+        kfp::rectp(c, s, e.r, e.t);
+      }
+      r = e.r;
+      t = e.t;
+    }
+    void clear() noexcept {
+      Entry zero;
+      zero.c = zero.s = F(0);
+      kfp::rectp(F(0), F(0), zero.r, zero.t);
+      for (Entry& e : entries) e = zero;
+      resetStatistics();
+    }
+    uint64_t hits() const noexcept { return nHits; }
+    uint64_t misses() const noexcept { return nMisses; }
+    void resetStatistics() noexcept { nHits = nMisses = 0; }
+    static constexpr size_t size() noexcept { return (size_t) 1 << logSize; }
+  private:
+    struct Entry {
+      F c, s, r;
+      frac32 t;
+    };
+    Entry entries[(size_t) 1 << logSize];
+    uint64_t nHits, nMisses;
+  };
+
+  // Per-thread caches, created on first use.
+  template<size_t logSize = 8>
+  SincosCache<logSize>& threadSincosCache() noexcept {
+    static thread_local SincosCache<logSize> cache;
+    return cache;
+  }
+  template<typename F, size_t logSize = 8>
+  RectpCache<F, logSize>& threadRectpCache() noexcept {
+    static thread_local RectpCache<F, logSize> cache;
+    return cache;
+  }
+  // sincos() and rectp() using the per-thread caches
+  inline void cachedSincos(frac32 t, s2_30& c, s2_30& s) noexcept {
+    threadSincosCache().sincos(t, c, s);
+  }
+  template<typename F>
+  void cachedRectp(F c, F s, F& r, frac32& t) noexcept {
+    threadRectpCache<F>().rectp(c, s, r, t);
+  }
+}
+
+#endif // KOZET_FIXED_POINT_KFP_CACHE_H
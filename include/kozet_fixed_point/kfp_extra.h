@@ -79,16 +79,22 @@ namespace kfp {
   // t = angle stored in a frac32 of a turn
   // c = reference to where you want cosine to be stored
   // s = reference to where you want sine to be stored
+  // iterations = maximum number of CORDIC iterations (at most
+  //   CORDIC_ITERATIONS are done)
   // Note: cosine and sine values are returned as s2_30 in order to represent both -1 and 1 correctly.
-  constexpr inline void sincos(frac32 t, s2_30& c, s2_30& s) noexcept {
+  constexpr inline void sincos(
+      frac32 t, s2_30& c, s2_30& s,
+      unsigned iterations = CORDIC_ITERATIONS) noexcept {
     // Check if angle (in radians) is greater than pi/2 or less than pi/2
     bool inv = t >= frac32::raw(0x40000000) && t < frac32::raw(0xC0000000u);
     // If so, then rotate by pi
     t += frac32::raw(0x80000000u * inv);
     s2_30 vx = CORDIC_K;
     s2_30 vy = 0;
+    if (iterations > CORDIC_ITERATIONS)
+      iterations = (unsigned) CORDIC_ITERATIONS;
     unsigned int i = 0;
-    for (; i < CORDIC_ITERATIONS && t != frac32(0); ++i) {
+    for (; i < iterations && t != frac32(0); ++i) {
       // new vector = [1, -factor; factor, 1] old vector
       s2_30 nx = vx - s2_30::raw(cnegi((vy.underlying >> i), t.underlying));
       s2_30 ny = vy + s2_30::raw(cnegi((vx.underlying >> i), t.underlying));
@@ -103,6 +109,18 @@ namespace kfp {
     c = inv ? -vx : vx;
     s = inv ? -vy : vy;
   }
+  // 16-bit variant of sincos
+  // t = angle stored in a frac16 of a turn
+  // The results are those of the 32-bit sincos, rounded to s2_14 (ties
+  // rounded up). Fewer iterations are not enough for correct rounding.
+  constexpr inline void sincos(frac16 t, s2_14& c, s2_14& s) noexcept {
+    s2_30 c30, s30;
+    sincos(frac32(t), c30, s30);
+    c = s2_14::raw((int16_t)
+      ((c30.underlying >> 16) + ((c30.underlying >> 15) & 1)));
+    s = s2_14::raw((int16_t)
+      ((s30.underlying >> 16) + ((s30.underlying >> 15) & 1)));
+  }
 
   // Calculating atan2 using CORDIC
   // c = cosine value
@@ -124,8 +142,9 @@ namespace kfp {
       c = -c;
       s = -s;
     }
-    constexpr unsigned iters = std::min(
-      CORDIC_ITERATIONS, CHAR_BIT * sizeof(typename F::Underlying));
+    constexpr size_t bits = CHAR_BIT * sizeof(typename F::Underlying);
+    constexpr unsigned iters =
+      (CORDIC_ITERATIONS < bits) ? CORDIC_ITERATIONS : bits;
     frac32 a = 0;
     F vx = c;
     F vy = s;
@@ -157,6 +176,45 @@ namespace kfp {
     if (inv) t += frac32::raw(0x80000000u);
   }
 
+  // Calculating only atan2 using CORDIC
+  // y = sine value
+  // x = cosine value
+  // iterations = maximum number of CORDIC iterations; after k iterations,
+  // the error is at most about atan(2**(1 - k)) radians
+  // Returns the same angle as rectp() when iterations is left at the
+  // default, but skips the magnitude correction.
+  template<typename I, size_t d>
+  constexpr frac32 atan2(
+      Fixed<I, d> y, Fixed<I, d> x,
+      unsigned iterations = CORDIC_ITERATIONS) noexcept {
+    using F = Fixed<I, d>;
+    bool inv = x < F(0); // Left of y-axis?
+    if (inv) {
+      x = -x;
+      y = -y;
+    }
+    constexpr size_t bits = CHAR_BIT * sizeof(I);
+    unsigned iters = (CORDIC_ITERATIONS < bits) ? CORDIC_ITERATIONS : bits;
+    if (iterations < iters) iters = iterations;
+    frac32 a = 0;
+    for (unsigned int i = 0; i < iters && y != F(0); ++i) {
+      F nx, ny;
+      if (y < F(0)) {
+        nx = x - (y >> i);
+        ny = (x >> i) + y;
+        a -= arctangentsT[i];
+      } else {
+        nx = x + (y >> i);
+        ny = -(x >> i) + y;
+        a += arctangentsT[i];
+      }
+      x = nx;
+      y = ny;
+    }
+    if (inv) a += frac32::raw(0x80000000u);
+    return a;
+  }
+
   template<typename I, size_t d>
   constexpr bool isInterior(
       Fixed<I, d> x, Fixed<I, d> y, Fixed<I, d> r) noexcept {
@@ -168,6 +226,189 @@ namespace kfp {
       ((D) r.underlying) * r.underlying;
     return hypot <= r2;
   }
+  // Returns x**2 + y**2, computed exactly in the double-width type.
+  template<typename I, size_t d>
+  constexpr Fixed<DoubleType<I>, 2 * d> magnitude2(
+      Fixed<I, d> x, Fixed<I, d> y) noexcept {
+    using D = DoubleType<I>;
+    return Fixed<DoubleType<I>, 2 * d>::raw(
+      ((D) x.underlying) * x.underlying +
+      ((D) y.underlying) * y.underlying);
+  }
+  // Compares the magnitudes of (x1, y1) and (x2, y2) without taking
+  // square roots. Returns a negative number, zero or a positive number if
+  // the first one is less than, equal to or greater than the second one.
+  template<typename I, size_t d>
+  constexpr int compareMagnitude(
+      Fixed<I, d> x1, Fixed<I, d> y1,
+      Fixed<I, d> x2, Fixed<I, d> y2) noexcept {
+    auto m1 = magnitude2(x1, y1);
+    auto m2 = magnitude2(x2, y2);
+    return (m1 > m2) - (m1 < m2);
+  }
+  // Returns true if the distance between (x1, y1) and (x2, y2) is at most
+  // r (which must not be negative). Unlike isInterior(x1 - x2, y1 - y2, r),
+  // the differences can't overflow.
+  template<typename I, size_t d>
+  constexpr bool isWithinDistance(
+      Fixed<I, d> x1, Fixed<I, d> y1,
+      Fixed<I, d> x2, Fixed<I, d> y2, Fixed<I, d> r) noexcept {
+    static_assert(std::is_signed<I>::value,
+      "isWithinDistance requires a signed underlying type");
+    using D = DoubleType<I>;
+    D dx = (D) x1.underlying - x2.underlying;
+    D dy = (D) y1.underlying - y2.underlying;
+    D rr = r.underlying;
+    // Reject early; this also ensures that the squares below fit in D
+    if (dx > rr || -dx > rr || dy > rr || -dy > rr) return false;
+    return dx * dx + dy * dy <= rr * rr;
+  }
+  // Exact predicates for segments (e. g. lasers).
+  // As with isInterior(), the differences between any two coördinates
+  // passed in must be representable in Fixed<I, d>. Dot and cross products
+  // are computed exactly in DoubleType<I>, and the segment-circle tests
+  // compare squares of those in DoubleType<DoubleType<I>>, so they support
+  // underlying types of up to 32 bits.
+  namespace segment_detail {
+    template<typename I>
+    using QuadType = DoubleType<DoubleType<I>>;
+    // Distance from (cx, cy) to the segment from (x1, y1) to (x1 + dx,
+    // y1 + dy) is at most r. len2 = dx * dx + dy * dy.
+    template<typename I, size_t d>
+    constexpr bool segmentCircle(
+        Fixed<I, d> x1, Fixed<I, d> y1, Fixed<I, d> dx, Fixed<I, d> dy,
+        DoubleType<I> len2,
+        Fixed<I, d> cx, Fixed<I, d> cy, Fixed<I, d> r) noexcept {
+      using D = DoubleType<I>;
+      using Q = QuadType<I>;
+      Fixed<I, d> fx = cx - x1, fy = cy - y1;
+      D t = ((D) fx.underlying) * dx.underlying +
+        ((D) fy.underlying) * dy.underlying;
+      // Closest point is the first endpoint
+      if (t <= 0) return isInterior(fx, fy, r);
+      // Closest point is the second endpoint
+      if (t >= len2) return isInterior(fx - dx, fy - dy, r);
+      // Closest point is in the middle: compare the distance from the line
+      // (cross / |d|) with r
+      D cross = ((D) dx.underlying) * fy.underlying -
+        ((D) dy.underlying) * fx.underlying;
+      D r2 = ((D) r.underlying) * r.underlying;
+      return ((Q) cross) * cross <= ((Q) r2) * len2;
+    }
+    // Sign of the cross product of (b - a) and (c - a)
+    template<typename I, size_t d>
+    constexpr int orientation(
+        Fixed<I, d> ax, Fixed<I, d> ay, Fixed<I, d> bx, Fixed<I, d> by,
+        Fixed<I, d> cx, Fixed<I, d> cy) noexcept {
+      using D = DoubleType<I>;
+      D cross = ((D) (bx - ax).underlying) * (cy - ay).underlying -
+        ((D) (by - ay).underlying) * (cx - ax).underlying;
+      return (cross > 0) - (cross < 0);
+    }
+    // Given that a, b and c are collinear, is c on the segment ab?
+    template<typename I, size_t d>
+    constexpr bool inBox(
+        Fixed<I, d> ax, Fixed<I, d> ay, Fixed<I, d> bx, Fixed<I, d> by,
+        Fixed<I, d> cx, Fixed<I, d> cy) noexcept {
+      return ((ax <= cx && cx <= bx) || (bx <= cx && cx <= ax)) &&
+        ((ay <= cy && cy <= by) || (by <= cy && cy <= ay));
+    }
+    template<typename I, size_t d>
+    constexpr bool segmentSegment(
+        Fixed<I, d> ax1, Fixed<I, d> ay1, Fixed<I, d> ax2, Fixed<I, d> ay2,
+        Fixed<I, d> bx1, Fixed<I, d> by1, Fixed<I, d> bx2, Fixed<I, d> by2)
+        noexcept {
+      int o1 = orientation(ax1, ay1, ax2, ay2, bx1, by1);
+      int o2 = orientation(ax1, ay1, ax2, ay2, bx2, by2);
+      int o3 = orientation(bx1, by1, bx2, by2, ax1, ay1);
+      int o4 = orientation(bx1, by1, bx2, by2, ax2, ay2);
+      if (o1 * o2 < 0 && o3 * o4 < 0) return true;
+      return
+        (o1 == 0 && inBox(ax1, ay1, ax2, ay2, bx1, by1)) ||
+        (o2 == 0 && inBox(ax1, ay1, ax2, ay2, bx2, by2)) ||
+        (o3 == 0 && inBox(bx1, by1, bx2, by2, ax1, ay1)) ||
+        (o4 == 0 && inBox(bx1, by1, bx2, by2, ax2, ay2));
+    }
+    template<typename Fn>
+    void fillMask(size_t n, uint32_t* mask, Fn&& f) {
+      for (size_t base = 0; base < n; base += 32) {
+        size_t m = (n - base < 32) ? n - base : 32;
+        uint32_t word = 0;
+        for (size_t i = 0; i < m; ++i)
+          word |= (uint32_t) f(base + i) << i;
+        mask[base / 32] = word;
+      }
+    }
+  }
+  // Returns true if the segment from (x1, y1) to (x2, y2) intersects the
+  // circle centred at (cx, cy) with radius r (boundary included).
+  template<typename I, size_t d>
+  constexpr bool segmentIntersectsCircle(
+      Fixed<I, d> x1, Fixed<I, d> y1, Fixed<I, d> x2, Fixed<I, d> y2,
+      Fixed<I, d> cx, Fixed<I, d> cy, Fixed<I, d> r) noexcept {
+    Fixed<I, d> dx = x2 - x1, dy = y2 - y1;
+    return segment_detail::segmentCircle(
+      x1, y1, dx, dy, magnitude2(dx, dy).underlying, cx, cy, r);
+  }
+  // Returns true if (px, py) is inside the capsule of radius r around the
+  // segment from (x1, y1) to (x2, y2) (boundary included).
+  template<typename I, size_t d>
+  constexpr bool isInCapsule(
+      Fixed<I, d> px, Fixed<I, d> py,
+      Fixed<I, d> x1, Fixed<I, d> y1, Fixed<I, d> x2, Fixed<I, d> y2,
+      Fixed<I, d> r) noexcept {
+    return segmentIntersectsCircle(x1, y1, x2, y2, px, py, r);
+  }
+  // Returns true if the segments from (ax1, ay1) to (ax2, ay2) and from
+  // (bx1, by1) to (bx2, by2) intersect (including touching).
+  template<typename I, size_t d>
+  constexpr bool segmentsIntersect(
+      Fixed<I, d> ax1, Fixed<I, d> ay1, Fixed<I, d> ax2, Fixed<I, d> ay2,
+      Fixed<I, d> bx1, Fixed<I, d> by1, Fixed<I, d> bx2, Fixed<I, d> by2)
+      noexcept {
+    return segment_detail::segmentSegment(
+      ax1, ay1, ax2, ay2, bx1, by1, bx2, by2);
+  }
+  // Batch versions: test one segment against n objects stored in separate
+  // arrays. Bit (i % 32) of mask[i / 32] is set to the result for object i;
+  // mask must have room for (n + 31) / 32 words.
+  template<typename I, size_t d>
+  void segmentIntersectsCircles(
+      Fixed<I, d> x1, Fixed<I, d> y1, Fixed<I, d> x2, Fixed<I, d> y2,
+      size_t n, const Fixed<I, d>* cx, const Fixed<I, d>* cy,
+      const Fixed<I, d>* r, uint32_t* mask) {
+    Fixed<I, d> dx = x2 - x1, dy = y2 - y1;
+    DoubleType<I> len2 = magnitude2(dx, dy).underlying;
+    segment_detail::fillMask(n, mask, [&](size_t i) {
+      return segment_detail::segmentCircle(
+        x1, y1, dx, dy, len2, cx[i], cy[i], r[i]);
+    });
+  }
+  template<typename I, size_t d>
+  void pointsInCapsule(
+      Fixed<I, d> x1, Fixed<I, d> y1, Fixed<I, d> x2, Fixed<I, d> y2,
+      Fixed<I, d> r,
+      size_t n, const Fixed<I, d>* px, const Fixed<I, d>* py,
+      uint32_t* mask) {
+    Fixed<I, d> dx = x2 - x1, dy = y2 - y1;
+    DoubleType<I> len2 = magnitude2(dx, dy).underlying;
+    segment_detail::fillMask(n, mask, [&](size_t i) {
+      return segment_detail::segmentCircle(
+        x1, y1, dx, dy, len2, px[i], py[i], r);
+    });
+  }
+  template<typename I, size_t d>
+  void segmentIntersectsSegments(
+      Fixed<I, d> x1, Fixed<I, d> y1, Fixed<I, d> x2, Fixed<I, d> y2,
+      size_t n,
+      const Fixed<I, d>* bx1, const Fixed<I, d>* by1,
+      const Fixed<I, d>* bx2, const Fixed<I, d>* by2,
+      uint32_t* mask) {
+    segment_detail::fillMask(n, mask, [&](size_t i) {
+      return segment_detail::segmentSegment(
+        x1, y1, x2, y2, bx1[i], by1[i], bx2[i], by2[i]);
+    });
+  }
   // Adapted from:
   // http://www.codecodex.com/wiki/Calculate_an_integer_square_root
   template<typename I>
@@ -193,7 +434,7 @@ namespace kfp {
     while (place != 0) {
       if (rem >= root + place) {
         rem -= root + place;
-        root += place *= 2;
+        root += place * 2;
       }
       root >>= 1;
       place >>= 2;
@@ -211,7 +452,7 @@ namespace kfp {
   template<typename I, size_t d>
   constexpr Fixed<I, d> hypot(Fixed<I, d> x, Fixed<I, d> y) noexcept {
     auto h2 = longMultiply(x, x) + longMultiply(y, y);
-    return sqrt(h2);
+    return sqrt<I, d>(h2);
   }
 }
 
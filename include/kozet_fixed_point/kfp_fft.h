@@ -0,0 +1,195 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#ifndef KOZET_FIXED_POINT_KFP_FFT_H
+#define KOZET_FIXED_POINT_KFP_FFT_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "./kfp.h"
+#include "./kfp_extra.h"
+
+namespace kfp {
+  template<typename F>
+  struct Complex {
+    F re, im;
+  };
+
+  // Largest supported transform length. Generating the twiddle factors for
+  // larger N exceeds GCC's default limit on constexpr evaluation.
+  static constexpr size_t FFT_MAX_SIZE = 16384;
+
+  // Twiddle factors exp(-2 pi i k / N) for k = 0, 1, ... N / 2 - 1,
+  // generated at compile time with sincos().
+  template<size_t N>
+  struct TwiddleTable {
+    static_assert(N >= 2 && (N & (N - 1)) == 0,
+      "N must be a power of two");
+    static_assert(N <= FFT_MAX_SIZE,
+      "N must be at most FFT_MAX_SIZE");
+    s2_30 c[N / 2];
+    s2_30 s[N / 2];
+    constexpr TwiddleTable() : c(), s() {
+      uint64_t step = ((uint64_t) 1 << 32) / N;
+      // Only the first octant calls sincos(); the rest of the table is
+      // filled in by symmetry.
+      for (size_t k = 0; k <= N / 8; ++k) {
+        // Negative angle, i. e. a clockwise rotation
+        frac32 t = frac32::raw((uint32_t) (((uint64_t) 1 << 32) - k * step));
+        sincos(t, c[k], s[k]);
+      }
+      for (size_t k = N / 8 + 1; k <= N / 4; ++k) {
+        // cos(pi / 2 - x) = sin x
+        c[k] = -s[N / 4 - k];
+        s[k] = -c[N / 4 - k];
+      }
+      for (size_t k = N / 4 + 1; k < N / 2; ++k) {
+        // cos(pi - x) = -cos x
+        c[k] = -c[N / 2 - k];
+        s[k] = s[N / 2 - k];
+      }
+    }
+  };
+  template<size_t N>
+  constexpr TwiddleTable<N> twiddles{};
+
+  // How to avoid overflow in the FFT.
+  enum class FftScaling {
+    // No scaling; the caller guarantees that nothing overflows.
+    none,
+    // Halve the values at every stage (the result is scaled by 1 / N).
+    // A butterfly at most doubles the largest magnitude, so this cannot
+    // overflow as long as every input has a magnitude less than the
+    // maximum of F (e. g. both components within +/- 23170 for s16_16).
+    perStage,
+    // Block floating point: before each stage, scale down by just as much
+    // as needed for that stage not to overflow.
+    block,
+  };
+
+  namespace fft_detail {
+    // Number of bits needed to represent x (an OR of absolute values).
+    template<typename U>
+    constexpr int bitLength(U x) noexcept {
+      int n = 0;
+      while (x != 0) {
+        x >>= 1;
+        ++n;
+      }
+      return n;
+    }
+    // An upper bound on |x|, suitable for OR-ing together.
+    template<typename I>
+    constexpr std::make_unsigned_t<I> absBits(I x) noexcept {
+      using U = std::make_unsigned_t<I>;
+      constexpr int bits = CHAR_BIT * sizeof(I);
+      return (U) (x ^ (x >> (bits - 1)));
+    }
+    template<typename I>
+    constexpr int shiftNeeded(std::make_unsigned_t<I> orAbs) noexcept {
+      // A radix-2 butterfly can grow each component by a factor of
+      // 1 + sqrt(2), so keep the inputs below a quarter of the range.
+      constexpr int bits = CHAR_BIT * sizeof(I);
+      int excess = bitLength(orAbs) - (bits - 3);
+      return excess > 0 ? excess : 0;
+    }
+    template<size_t N, typename I, size_t d>
+    int transform(
+        Complex<Fixed<I, d>>* data, FftScaling scaling, bool inverse)
+        noexcept {
+      static_assert(std::is_signed<I>::value,
+        "FFT requires a signed underlying type");
+      using F = Fixed<I, d>;
+      using D = DoubleType<I>;
+      using U = std::make_unsigned_t<I>;
+      constexpr int wBits = s2_30::fractionalBits();
+      constexpr int logN = bitLength(N) - 1;
+      const TwiddleTable<N>& w = twiddles<N>;
+      // Bit-reversal permutation
+      U orAbs = 0;
+      for (size_t i = 0, j = 0; i < N; ++i) {
+        if (i < j) std::swap(data[i], data[j]);
+        orAbs |= absBits(data[i].re.underlying) |
+          absBits(data[i].im.underlying);
+        size_t bit = N >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+      }
+      int exponent = 0;
+      for (int stage = 0; stage < logN; ++stage) {
+        size_t half = (size_t) 1 << stage;
+        size_t len = half << 1;
+        size_t tStep = N / len;
+        int shift = 0;
+        if (scaling == FftScaling::perStage) shift = 1;
+        else if (scaling == FftScaling::block) shift = shiftNeeded<I>(orAbs);
+        exponent += shift;
+        int totalShift = wBits + shift;
+        D round = (D) 1 << (totalShift - 1);
+        orAbs = 0;
+        // Each butterfly is computed exactly in the double-width type
+        // with 30 extra fractional bits and rounded once.
+        for (size_t start = 0; start < N; start += len) {
+          Complex<F>* a = data + start;
+          Complex<F>* b = a + half;
+          for (size_t k = 0; k < half; ++k) {
+            D wr = w.c[k * tStep].underlying;
+            D wi = inverse ?
+              -(D) w.s[k * tStep].underlying : w.s[k * tStep].underlying;
+            D br = b[k].re.underlying, bi = b[k].im.underlying;
+            D tr = br * wr - bi * wi;
+            D ti = br * wi + bi * wr;
+            // Multiply instead of shifting, since the values can be negative
+            D ar = (D) a[k].re.underlying * ((D) 1 << wBits);
+            D ai = (D) a[k].im.underlying * ((D) 1 << wBits);
+            I r0 = (I) ((ar + tr + round) >> totalShift);
+            I i0 = (I) ((ai + ti + round) >> totalShift);
+            I r1 = (I) ((ar - tr + round) >> totalShift);
+            I i1 = (I) ((ai - ti + round) >> totalShift);
+            a[k].re.underlying = r0; a[k].im.underlying = i0;
+            b[k].re.underlying = r1; b[k].im.underlying = i1;
+            orAbs |= absBits(r0) | absBits(i0) | absBits(r1) | absBits(i1);
+          }
+        }
+      }
+      return exponent;
+    }
+  }
+
+  // In-place radix-2 FFT of N complex values.
+  // Returns an exponent e such that the true transform is data * 2**e.
+  template<size_t N, typename I, size_t d>
+  int fft(Complex<Fixed<I, d>>* data,
+      FftScaling scaling = FftScaling::block) noexcept {
+    return fft_detail::transform<N>(data, scaling, false);
+  }
+
+  // In-place inverse FFT of N complex values, without the 1 / N factor.
+  // Returns an exponent e such that the true result is data * 2**e.
+  template<size_t N, typename I, size_t d>
+  int ifft(Complex<Fixed<I, d>>* data,
+      FftScaling scaling = FftScaling::block) noexcept {
+    return fft_detail::transform<N>(data, scaling, true);
+  }
+}
+
+#endif // KOZET_FIXED_POINT_KFP_FFT_H
@@ -0,0 +1,254 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#ifndef KOZET_FIXED_POINT_KFP_HASH_H
+#define KOZET_FIXED_POINT_KFP_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "./kfp.h"
+
+namespace kfp {
+  // Checksums for detecting desyncs between simulations that are supposed
+  // to be identical.
+  //
+  // A sequence of Fixed values is hashed as the concatenation of the
+  // little-endian representations of their underlying values, using
+  // XXH64 (https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md).
+  // The result is the same on every platform, and XXH64's four independent
+  // lanes let the compiler keep several multiplications in flight at once.
+  namespace hash_detail {
+    static constexpr uint64_t P1 = 0x9E3779B185EBCA87u;
+    static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Fu;
+    static constexpr uint64_t P3 = 0x165667B19E3779F9u;
+    static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63u;
+    static constexpr uint64_t P5 = 0x27D4EB2F165667C5u;
+    constexpr inline uint64_t rotl(uint64_t x, int r) noexcept {
+      return (x << r) | (x >> (64 - r));
+    }
+    constexpr inline uint64_t round(uint64_t acc, uint64_t input) noexcept {
+      acc += input * P2;
+      acc = rotl(acc, 31);
+      return acc * P1;
+    }
+    constexpr inline uint64_t mergeRound(uint64_t acc, uint64_t val) noexcept {
+      acc ^= round(0, val);
+      return acc * P1 + P4;
+    }
+    constexpr inline uint64_t avalanche(uint64_t h) noexcept {
+      h ^= h >> 33;
+      h *= P2;
+      h ^= h >> 29;
+      h *= P3;
+      h ^= h >> 32;
+      return h;
+    }
+    constexpr inline bool isLittleEndian() noexcept {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      return false;
+#else
+      return true;
+#endif
+    }
+    inline uint64_t read64(const unsigned char* p) noexcept {
+      uint64_t x;
+      if (isLittleEndian()) {
+        memcpy(&x, p, sizeof(x));
+        return x;
+      }
+      x = 0;
+      for (int i = 7; i >= 0; --i) x = (x << 8) | p[i];
+      return x;
+    }
+    inline uint32_t read32(const unsigned char* p) noexcept {
+      uint32_t x;
+      if (isLittleEndian()) {
+        memcpy(&x, p, sizeof(x));
+        return x;
+      }
+      x = 0;
+      for (int i = 3; i >= 0; --i) x = (x << 8) | p[i];
+      return x;
+    }
+  }
+
+  // Streaming hasher. Feed it with update() as many times as needed;
+  // the digest is the XXH64 of everything passed in so far.
+  class StateHasher {
+  public:
+    explicit StateHasher(uint64_t seed = 0) noexcept { reset(seed); }
+    void reset(uint64_t seed = 0) noexcept {
+      using namespace hash_detail;
+      v[0] = seed + P1 + P2;
+      v[1] = seed + P2;
+      v[2] = seed;
+      v[3] = seed - P1;
+      this->seed = seed;
+      totalLength = 0;
+      bufferSize = 0;
+    }
+    // Hashes raw bytes.
+    void update(const void* data, size_t length) noexcept {
+      const unsigned char* p = (const unsigned char*) data;
+      totalLength += length;
+      if (bufferSize + length < 32) {
+        memcpy(buffer + bufferSize, p, length);
+        bufferSize += length;
+        return;
+      }
+      if (bufferSize != 0) {
+        size_t fill = 32 - bufferSize;
+        memcpy(buffer + bufferSize, p, fill);
+        consume(buffer, 1);
+        p += fill;
+        length -= fill;
+        bufferSize = 0;
+      }
+      size_t stripes = length / 32;
+      consume(p, stripes);
+      p += 32 * stripes;
+      length -= 32 * stripes;
+      memcpy(buffer, p, length);
+      bufferSize = length;
+    }
+    // Hashes an array of fixed-point values.
+    template<typename I, size_t d>
+    void update(const Fixed<I, d>* data, size_t n) noexcept {
+      static_assert(sizeof(Fixed<I, d>) == sizeof(I),
+        "Fixed<I, d> must have the same layout as I");
+      if (hash_detail::isLittleEndian()) {
+        update((const void*) data, n * sizeof(I));
+        return;
+      }
+      for (size_t i = 0; i < n; ++i) update(data[i]);
+    }
+    // Hashes a single fixed-point value.
+    template<typename I, size_t d>
+    void update(Fixed<I, d> x) noexcept {
+      using U = std::make_unsigned_t<I>;
+      U u = (U) x.underlying;
+      unsigned char bytes[sizeof(I)];
+      for (size_t i = 0; i < sizeof(I); ++i) {
+        bytes[i] = (unsigned char) u;
+        u = (U) (u >> 8);
+      }
+      update((const void*) bytes, sizeof(I));
+    }
+    uint64_t digest() const noexcept {
+      using namespace hash_detail;
+      uint64_t h;
+      if (totalLength >= 32) {
+        h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+        for (int i = 0; i < 4; ++i) h = mergeRound(h, v[i]);
+      } else {
+        h = seed + P5;
+      }
+      h += totalLength;
+      const unsigned char* p = buffer;
+      size_t length = bufferSize;
+      for (; length >= 8; p += 8, length -= 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * P1 + P4;
+      }
+      if (length >= 4) {
+        h ^= (uint64_t) read32(p) * P1;
+        h = rotl(h, 23) * P2 + P3;
+        p += 4;
+        length -= 4;
+      }
+      for (; length > 0; ++p, --length) {
+        h ^= *p * P5;
+        h = rotl(h, 11) * P1;
+      }
+      return avalanche(h);
+    }
+  private:
+    uint64_t v[4];
+    uint64_t seed;
+    uint64_t totalLength;
+    unsigned char buffer[32];
+    size_t bufferSize;
+    void consume(const unsigned char* p, size_t stripes) noexcept {
+      using namespace hash_detail;
+      // Local copies so that the lanes stay in registers
+      uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+      for (size_t i = 0; i < stripes; ++i, p += 32) {
+        v0 = round(v0, read64(p));
+        v1 = round(v1, read64(p + 8));
+        v2 = round(v2, read64(p + 16));
+        v3 = round(v3, read64(p + 24));
+      }
+      v[0] = v0; v[1] = v1; v[2] = v2; v[3] = v3;
+    }
+  };
+
+  // One-shot convenience function
+  template<typename I, size_t d>
+  uint64_t checksum(
+      const Fixed<I, d>* data, size_t n, uint64_t seed = 0) noexcept {
+    StateHasher h(seed);
+    h.update(data, n);
+    return h.digest();
+  }
+
+  // Incremental checksum over a fixed-size array of values: the checksum
+  // is the sum (mod 2**64) of a mix of each index and value, so changing
+  // one element costs O(1) instead of rehashing the whole array.
+  // This is weaker than StateHasher, but useful when only a few elements
+  // change each frame.
+  class IncrementalChecksum {
+  public:
+    explicit IncrementalChecksum(uint64_t seed = 0) noexcept :
+      seed(seed), sum(0) {}
+    template<typename I, size_t d>
+    void add(size_t index, Fixed<I, d> x) noexcept {
+      sum += mix(index, x);
+    }
+    template<typename I, size_t d>
+    void remove(size_t index, Fixed<I, d> x) noexcept {
+      sum -= mix(index, x);
+    }
+    template<typename I, size_t d>
+    void replace(size_t index, Fixed<I, d> oldValue, Fixed<I, d> newValue)
+        noexcept {
+      sum += mix(index, newValue) - mix(index, oldValue);
+    }
+    template<typename I, size_t d>
+    void addAll(const Fixed<I, d>* data, size_t n) noexcept {
+      for (size_t i = 0; i < n; ++i) add(i, data[i]);
+    }
+    uint64_t digest() const noexcept {
+      return hash_detail::avalanche(sum ^ seed);
+    }
+  private:
+    uint64_t seed;
+    uint64_t sum;
+    template<typename I, size_t d>
+    uint64_t mix(size_t index, Fixed<I, d> x) const noexcept {
+      static_assert(sizeof(I) <= sizeof(uint64_t),
+        "IncrementalChecksum supports underlying types up to 64 bits");
+      using namespace hash_detail;
+      uint64_t u = (uint64_t) (std::make_unsigned_t<I>) x.underlying;
+      return avalanche(round(seed + (uint64_t) index * P5, u));
+    }
+  };
+}
+
+#endif // KOZET_FIXED_POINT_KFP_HASH_H
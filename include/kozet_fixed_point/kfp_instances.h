@@ -0,0 +1,63 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#ifndef KOZET_FIXED_POINT_KFP_INSTANCES_H
+#define KOZET_FIXED_POINT_KFP_INSTANCES_H
+
+#include "./kfp.h"
+
+// Compiled versions of the functions in kfp_extra.h for the common
+// aliases, defined in libkfp (built by `make lib`).
+//
+// Everything in kfp_extra.h is constexpr, and therefore inline, so it is
+// compiled again in every translation unit that calls it; an extern
+// template declaration does not prevent this. The functions below are
+// ordinary functions instead, so a translation unit that includes this
+// header instead of kfp_extra.h only compiles calls to them. They return
+// exactly what the functions of the same names in kfp_extra.h return with
+// the default number of iterations, but are not constexpr and cannot be
+// inlined without link-time optimisation.
+namespace kfp {
+  namespace lib {
+    void sincos(frac32 t, s2_30& c, s2_30& s) noexcept;
+    void sincos(frac16 t, s2_14& c, s2_14& s) noexcept;
+
+#define KFP_LIB_DECLARE(F) \
+    void rectp(F c, F s, F& r, frac32& t) noexcept; \
+    frac32 atan2(F y, F x) noexcept; \
+    bool isInterior(F x, F y, F r) noexcept; \
+    DoubleType<F> magnitude2(F x, F y) noexcept; \
+    bool isWithinDistance(F x1, F y1, F x2, F y2, F r) noexcept; \
+    F hypot(F x, F y) noexcept;
+    KFP_LIB_DECLARE(s16_16)
+    KFP_LIB_DECLARE(s2_30)
+    KFP_LIB_DECLARE(s34_30)
+#undef KFP_LIB_DECLARE
+
+    bool segmentIntersectsCircle(
+      s16_16 x1, s16_16 y1, s16_16 x2, s16_16 y2,
+      s16_16 cx, s16_16 cy, s16_16 r) noexcept;
+    bool segmentsIntersect(
+      s16_16 ax1, s16_16 ay1, s16_16 ax2, s16_16 ay2,
+      s16_16 bx1, s16_16 by1, s16_16 bx2, s16_16 by2) noexcept;
+    int32_t sqrti(int32_t n) noexcept;
+    int64_t sqrti(int64_t n) noexcept;
+  }
+}
+
+#endif // KOZET_FIXED_POINT_KFP_INSTANCES_H
@@ -0,0 +1,367 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#ifndef KOZET_FIXED_POINT_KFP_INT128_H
+#define KOZET_FIXED_POINT_KFP_INT128_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <type_traits>
+
+namespace kfp {
+  // Portable 128-bit integers for compilers that lack __int128.
+  // Values are stored as two 64-bit halves in two's complement, and all
+  // operations wrap around modulo 2**128 (including for the signed
+  // variant), except for division by zero, which traps like the built-in
+  // 64-bit division does.
+  namespace int128_detail {
+    constexpr inline int clz64(uint64_t x) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+      return x == 0 ? 64 : __builtin_clzll(x);
+#else
+      int n = 0;
+      if (x == 0) return 64;
+      while (!(x & 0x8000'0000'0000'0000u)) {
+        x <<= 1;
+        ++n;
+      }
+      return n;
+#endif
+    }
+    // Full 64 * 64 -> 128 multiplication, built from 32 * 32 products.
+    constexpr inline uint64_t mul64(
+        uint64_t a, uint64_t b, uint64_t& hi) noexcept {
+      uint64_t a0 = (uint32_t) a, a1 = a >> 32;
+      uint64_t b0 = (uint32_t) b, b1 = b >> 32;
+      uint64_t p00 = a0 * b0, p01 = a0 * b1;
+      uint64_t p10 = a1 * b0, p11 = a1 * b1;
+      uint64_t mid = (p00 >> 32) + (uint32_t) p01 + (uint32_t) p10;
+      hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+      return (mid << 32) | (uint32_t) p00;
+    }
+    // Divides the 128-bit value (u1, u0) by v, returning the quotient and
+    // storing the remainder in r. Requires u1 < v.
+    // Adapted from divlu2 in Hacker's Delight (2nd edition), fig. 9-3.
+    constexpr inline uint64_t divlu(
+        uint64_t u1, uint64_t u0, uint64_t v, uint64_t& r) noexcept {
+      const uint64_t b = (uint64_t) 1 << 32;
+      int s = clz64(v);
+      v <<= s;
+      uint64_t vn1 = v >> 32, vn0 = (uint32_t) v;
+      uint64_t un32 = (s == 0) ? u1 : (u1 << s) | (u0 >> (64 - s));
+      uint64_t un10 = u0 << s;
+      uint64_t un1 = un10 >> 32, un0 = (uint32_t) un10;
+      uint64_t q1 = un32 / vn1;
+      uint64_t rhat = un32 - q1 * vn1;
+      while (q1 >= b || q1 * vn0 > b * rhat + un1) {
+        --q1;
+        rhat += vn1;
+        if (rhat >= b) break;
+      }
+      uint64_t un21 = un32 * b + un1 - q1 * v;
+      uint64_t q0 = un21 / vn1;
+      rhat = un21 - q0 * vn1;
+      while (q0 >= b || q0 * vn0 > b * rhat + un0) {
+        --q0;
+        rhat += vn1;
+        if (rhat >= b) break;
+      }
+      r = (un21 * b + un0 - q0 * v) >> s;
+      return q1 * b + q0;
+    }
+    template<typename T>
+    constexpr std::enable_if_t<std::is_signed<T>::value, uint64_t>
+    signExtension(T x) noexcept {
+      return (x < 0) ? ~(uint64_t) 0 : 0;
+    }
+    template<typename T>
+    constexpr std::enable_if_t<!std::is_signed<T>::value, uint64_t>
+    signExtension(T) noexcept {
+      return 0;
+    }
+  }
+
+  template<bool S>
+  struct BasicInt128 {
+    using B = BasicInt128<S>;
+    uint64_t lo, hi;
+    // Constructors
+    constexpr BasicInt128() noexcept : lo(0), hi(0) {}
+    template<typename T,
+      std::enable_if_t<std::is_integral<T>::value, int> = 0>
+    constexpr BasicInt128(T x) noexcept :
+      lo((uint64_t) x), hi(int128_detail::signExtension(x)) {}
+    explicit constexpr BasicInt128(const BasicInt128<!S>& other) noexcept :
+      lo(other.lo), hi(other.hi) {}
+    template<typename T,
+      std::enable_if_t<std::is_floating_point<T>::value, int> = 0>
+    explicit constexpr BasicInt128(T x) noexcept : lo(0), hi(0) {
+      bool neg = x < 0;
+      double y = neg ? -(double) x : (double) x;
+      hi = (uint64_t) (y / 18446744073709551616.0);
+      lo = (uint64_t) (y - hi * 18446744073709551616.0);
+      if (neg) *this = -*this;
+    }
+    constexpr static B fromParts(uint64_t hi, uint64_t lo) noexcept {
+      B ret;
+      ret.hi = hi;
+      ret.lo = lo;
+      return ret;
+    }
+    // Conversions
+    template<typename T,
+      std::enable_if_t<
+        std::is_integral<T>::value && !std::is_same<T, bool>::value,
+        int> = 0>
+    explicit constexpr operator T() const noexcept {
+      return (T) lo;
+    }
+    explicit constexpr operator bool() const noexcept {
+      return (lo | hi) != 0;
+    }
+    constexpr bool isNegative() const noexcept {
+      return S && (hi >> 63) != 0;
+    }
+    explicit constexpr operator double() const noexcept {
+      if (isNegative()) return -(double) BasicInt128<false>(-*this);
+      if (hi == 0) return (double) lo;
+      // Normalise, keeping any discarded bits as a sticky bit so that the
+      // result is rounded only once
+      int n = int128_detail::clz64(hi);
+      B x = *this << n;
+      uint64_t top = x.hi | (x.lo != 0);
+      double scale = (n == 0) ?
+        18446744073709551616.0 : (double) ((uint64_t) 1 << (64 - n));
+      return (double) top * scale;
+    }
+    explicit constexpr operator float() const noexcept {
+      return (float) (double) *this;
+    }
+    // Arithmetic
+    constexpr B operator+() const noexcept { return *this; }
+    constexpr B operator-() const noexcept {
+      return fromParts(~hi + (lo == 0), ~lo + 1);
+    }
+    constexpr B operator~() const noexcept {
+      return fromParts(~hi, ~lo);
+    }
+    friend constexpr B operator+(B a, B b) noexcept {
+      uint64_t lo = a.lo + b.lo;
+      return fromParts(a.hi + b.hi + (lo < a.lo), lo);
+    }
+    friend constexpr B operator-(B a, B b) noexcept {
+      return fromParts(a.hi - b.hi - (a.lo < b.lo), a.lo - b.lo);
+    }
+    friend constexpr B operator*(B a, B b) noexcept {
+      uint64_t hi = 0;
+      uint64_t lo = int128_detail::mul64(a.lo, b.lo, hi);
+      hi += a.lo * b.hi + a.hi * b.lo;
+      return fromParts(hi, lo);
+    }
+    friend constexpr B operator/(B a, B b) noexcept {
+      B q, r;
+      divmod(a, b, q, r);
+      return q;
+    }
+    friend constexpr B operator%(B a, B b) noexcept {
+      B q, r;
+      divmod(a, b, q, r);
+      return r;
+    }
+    friend constexpr B operator&(B a, B b) noexcept {
+      return fromParts(a.hi & b.hi, a.lo & b.lo);
+    }
+    friend constexpr B operator|(B a, B b) noexcept {
+      return fromParts(a.hi | b.hi, a.lo | b.lo);
+    }
+    friend constexpr B operator^(B a, B b) noexcept {
+      return fromParts(a.hi ^ b.hi, a.lo ^ b.lo);
+    }
+    friend constexpr B operator<<(B a, int s) noexcept {
+      if (s == 0) return a;
+      if (s >= 64) return fromParts(a.lo << (s - 64), 0);
+      return fromParts((a.hi << s) | (a.lo >> (64 - s)), a.lo << s);
+    }
+    friend constexpr B operator>>(B a, int s) noexcept {
+      // Arithmetic shift for the signed variant
+      uint64_t fill = a.isNegative() ? ~(uint64_t) 0 : 0;
+      if (s == 0) return a;
+      if (s >= 64) {
+        uint64_t lo = (s == 64) ? a.hi :
+          (a.hi >> (s - 64)) | (fill << (128 - s));
+        return fromParts(fill, lo);
+      }
+      return fromParts(
+        (a.hi >> s) | (fill << (64 - s)),
+        (a.lo >> s) | (a.hi << (64 - s)));
+    }
+    // Relations
+    friend constexpr bool operator==(B a, B b) noexcept {
+      return a.hi == b.hi && a.lo == b.lo;
+    }
+    friend constexpr bool operator!=(B a, B b) noexcept {
+      return !(a == b);
+    }
+    friend constexpr bool operator<(B a, B b) noexcept {
+      // Flipping the sign bit turns a signed comparison into an unsigned one
+      uint64_t ah = a.hi ^ (S ? 0x8000'0000'0000'0000u : 0);
+      uint64_t bh = b.hi ^ (S ? 0x8000'0000'0000'0000u : 0);
+      return ah < bh || (ah == bh && a.lo < b.lo);
+    }
+    friend constexpr bool operator>(B a, B b) noexcept { return b < a; }
+    friend constexpr bool operator<=(B a, B b) noexcept { return !(b < a); }
+    friend constexpr bool operator>=(B a, B b) noexcept { return !(a < b); }
+    // Compound assignment
+#define DEF_ASSIGN(o) \
+    constexpr B& operator o##=(B other) noexcept { \
+      *this = *this o other; \
+      return *this; \
+    }
+    DEF_ASSIGN(+)
+    DEF_ASSIGN(-)
+    DEF_ASSIGN(*)
+    DEF_ASSIGN(/)
+    DEF_ASSIGN(%)
+    DEF_ASSIGN(&)
+    DEF_ASSIGN(|)
+    DEF_ASSIGN(^)
+#undef DEF_ASSIGN
+    constexpr B& operator<<=(int s) noexcept {
+      *this = *this << s;
+      return *this;
+    }
+    constexpr B& operator>>=(int s) noexcept {
+      *this = *this >> s;
+      return *this;
+    }
+    constexpr B& operator++() noexcept { return *this += 1; }
+    constexpr B& operator--() noexcept { return *this -= 1; }
+    constexpr B operator++(int) noexcept {
+      B ret = *this;
+      *this += 1;
+      return ret;
+    }
+    constexpr B operator--(int) noexcept {
+      B ret = *this;
+      *this -= 1;
+      return ret;
+    }
+  private:
+    // Unsigned division of n by d.
+    static constexpr void divmodU(B n, B d, B& q, B& r) noexcept {
+      using namespace int128_detail;
+      if (d.hi == 0) {
+        if (n.hi == 0) {
+          // Only one 64-bit division needed
+          q = fromParts(0, n.lo / d.lo);
+          r = fromParts(0, n.lo % d.lo);
+          return;
+        }
+        uint64_t rem = 0;
+        uint64_t qhi = 0;
+        uint64_t nhi = n.hi;
+        if (nhi >= d.lo) {
+          qhi = nhi / d.lo;
+          nhi %= d.lo;
+        }
+        uint64_t qlo = divlu(nhi, n.lo, d.lo, rem);
+        q = fromParts(qhi, qlo);
+        r = fromParts(0, rem);
+        return;
+      }
+      // The quotient fits in 64 bits. Estimate it by dividing by the top
+      // 64 bits of the normalised divisor, then correct it.
+      int s = clz64(d.hi);
+      uint64_t v1 = (BasicInt128<false>(d) << s).hi;
+      BasicInt128<false> u1 = BasicInt128<false>(n) >> 1;
+      uint64_t junk = 0;
+      uint64_t q1 = divlu(u1.hi, u1.lo, v1, junk);
+      uint64_t q0 = q1 >> (63 - s);
+      if (q0 != 0) --q0;
+      BasicInt128<false> un(n), dn(d);
+      BasicInt128<false> rem = un - BasicInt128<false>(q0) * dn;
+      if (rem >= dn) {
+        ++q0;
+        rem -= dn;
+      }
+      q = fromParts(0, q0);
+      r = B(rem);
+    }
+    // Division truncating towards zero, as with built-in types.
+    static constexpr void divmod(B n, B d, B& q, B& r) noexcept {
+      bool nn = n.isNegative(), dn = d.isNegative();
+      if (nn) n = -n;
+      if (dn) d = -d;
+      divmodU(n, d, q, r);
+      if (nn != dn) q = -q;
+      if (nn) r = -r;
+    }
+  };
+  using Int128 = BasicInt128<true>;
+  using UInt128 = BasicInt128<false>;
+}
+
+template<bool S>
+struct std::numeric_limits<kfp::BasicInt128<S>> {
+  using B = kfp::BasicInt128<S>;
+  static constexpr bool is_specialized = true;
+  static constexpr bool is_signed = S;
+  static constexpr bool is_integer = true;
+  static constexpr bool is_exact = true;
+  static constexpr bool has_infinity = false;
+  static constexpr bool has_quiet_NaN = false;
+  static constexpr bool has_signaling_NaN = false;
+  static constexpr std::float_denorm_style has_denorm =
+    std::float_denorm_style::denorm_absent;
+  static constexpr bool has_denorm_loss = false;
+  static constexpr std::float_round_style round_style =
+    std::float_round_style::round_toward_zero;
+  static constexpr bool is_iec559 = false;
+  static constexpr bool is_bounded = true;
+  static constexpr bool is_modulo = !S;
+  static constexpr int digits = S ? 127 : 128;
+  static constexpr int digits10 = 38;
+  static constexpr int max_digits10 = 0;
+  static constexpr int radix = 2;
+  static constexpr int min_exponent = 0;
+  static constexpr int max_exponent = 0;
+  static constexpr int min_exponent10 = 0;
+  static constexpr int max_exponent10 = 0;
+  static constexpr bool traps = true;
+  static constexpr bool tinyness_before = false;
+  static constexpr B min() noexcept {
+    return B::fromParts(S ? 0x8000'0000'0000'0000u : 0, 0);
+  }
+  static constexpr B max() noexcept {
+    return B::fromParts(
+      S ? 0x7FFF'FFFF'FFFF'FFFFu : 0xFFFF'FFFF'FFFF'FFFFu,
+      0xFFFF'FFFF'FFFF'FFFFu);
+  }
+  static constexpr B lowest() noexcept { return min(); }
+  static constexpr B epsilon() noexcept { return B(); }
+  static constexpr B round_error() noexcept { return B(); }
+  static constexpr B infinity() noexcept { return B(); }
+  static constexpr B quiet_NaN() noexcept { return B(); }
+  static constexpr B signaling_NaN() noexcept { return B(); }
+  static constexpr B denorm_min() noexcept { return B(); }
+};
+
+#endif // KOZET_FIXED_POINT_KFP_INT128_H
@@ -0,0 +1,169 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#ifndef KOZET_FIXED_POINT_KFP_INTEGRATE_H
+#define KOZET_FIXED_POINT_KFP_INTEGRATE_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <type_traits>
+
+#include "./kfp.h"
+
+namespace kfp {
+  // Batch integration of particles stored as separate arrays of
+  // coördinates (x, y), velocities (vx, vy) and optionally accelerations
+  // (ax, ay).
+  //
+  // Each axis is updated in a separate branch-free loop over pointers that
+  // are assumed not to alias, so that the compiler can vectorise the loops
+  // for 32-bit underlying types. The arrays passed to these functions must
+  // therefore not overlap.
+
+  // Order of updates in each step.
+  enum class Scheme {
+    // x += vx; vx += ax
+    euler,
+    // vx += ax; x += vx
+    // (equivalent to leapfrog / position Verlet with one step per frame)
+    symplecticEuler,
+  };
+  // A rectangle with inclusive bounds.
+  template<typename F>
+  struct Bounds {
+    F xmin, ymin, xmax, ymax;
+    constexpr bool contains(F x, F y) const noexcept {
+      return (x >= xmin) & (x <= xmax) & (y >= ymin) & (y <= ymax);
+    }
+  };
+
+  // Adds two values with the given overflow behaviour.
+  // Unlike Fixed::operator+, Overflow::wrap is well-defined for signed
+  // types.
+  template<Overflow o, typename I, size_t d>
+  constexpr Fixed<I, d> addWith(Fixed<I, d> a, Fixed<I, d> b) noexcept {
+    using U = std::make_unsigned_t<I>;
+    constexpr int bits = CHAR_BIT * sizeof(I);
+    U ua = (U) a.underlying, ub = (U) b.underlying;
+    U r = (U) (ua + ub);
+    if (o == Overflow::wrap) return Fixed<I, d>::raw((I) r);
+    if (std::is_signed<I>::value) {
+      // Overflow iff both operands have a different sign from the result
+      bool overflow = ((ua ^ r) & (ub ^ r)) >> (bits - 1);
+      U sat = (U) std::numeric_limits<I>::max() + (ua >> (bits - 1));
+      return Fixed<I, d>::raw((I) (overflow ? sat : r));
+    }
+    return Fixed<I, d>::raw((I) (r < ua ? (U) ~(U) 0 : r));
+  }
+
+  namespace integrate_detail {
+    template<Scheme s, Overflow o, typename F>
+    inline void step(F& x, F& v, F a) noexcept {
+      if (s == Scheme::euler) {
+        x = addWith<o>(x, v);
+        v = addWith<o>(v, a);
+      } else {
+        v = addWith<o>(v, a);
+        x = addWith<o>(x, v);
+      }
+    }
+    // Updates one axis of n particles.
+    template<Scheme s, Overflow o, typename F>
+    inline void stepAxis(
+        size_t n, F* __restrict x, F* __restrict v,
+        const F* __restrict a) noexcept {
+      for (size_t i = 0; i < n; ++i) {
+        F xi = x[i], vi = v[i];
+        step<s, o>(xi, vi, a[i]);
+        x[i] = xi; v[i] = vi;
+      }
+    }
+    template<Overflow o, typename F>
+    inline void moveAxis(
+        size_t n, F* __restrict x, const F* __restrict v) noexcept {
+      for (size_t i = 0; i < n; ++i) x[i] = addWith<o>(x[i], v[i]);
+    }
+  }
+
+  // Advances n particles by one step.
+  // ax and ay may be null, in which case the velocities are unchanged.
+  template<
+    Scheme s = Scheme::euler, Overflow o = Overflow::wrap,
+    typename I, size_t d>
+  void integrate(
+      size_t n,
+      Fixed<I, d>* x, Fixed<I, d>* y,
+      Fixed<I, d>* vx, Fixed<I, d>* vy,
+      const Fixed<I, d>* ax = nullptr,
+      const Fixed<I, d>* ay = nullptr) noexcept {
+    if (ax == nullptr || ay == nullptr) {
+      integrate_detail::moveAxis<o>(n, x, vx);
+      integrate_detail::moveAxis<o>(n, y, vy);
+      return;
+    }
+    integrate_detail::stepAxis<s, o>(n, x, vx, ax);
+    integrate_detail::stepAxis<s, o>(n, y, vy, ay);
+  }
+
+  // Same as integrate(), but also checks the new positions against bounds.
+  // The indices of particles that are still inside are written in
+  // increasing order to survivors, which must have room for n entries.
+  // Returns the number of survivors.
+  template<
+    Scheme s = Scheme::euler, Overflow o = Overflow::wrap,
+    typename I, size_t d>
+  size_t integrateAndCull(
+      size_t n,
+      Fixed<I, d>* x, Fixed<I, d>* y,
+      Fixed<I, d>* vx, Fixed<I, d>* vy,
+      const Fixed<I, d>* ax, const Fixed<I, d>* ay,
+      const Bounds<Fixed<I, d>>& bounds,
+      uint32_t* survivors) noexcept {
+    using F = Fixed<I, d>;
+    // Work in blocks small enough to stay in L1 cache: update each axis
+    // of a block and flag it with vectorisable loops, then compact it.
+    constexpr size_t BLOCK = 256;
+    unsigned char inside[BLOCK];
+    bool hasAccel = ax != nullptr && ay != nullptr;
+    size_t count = 0;
+    for (size_t base = 0; base < n; base += BLOCK) {
+      size_t m = (n - base < BLOCK) ? n - base : BLOCK;
+      F* bx = x + base; F* by = y + base;
+      F* bvx = vx + base; F* bvy = vy + base;
+      if (hasAccel) {
+        integrate_detail::stepAxis<s, o>(m, bx, bvx, ax + base);
+        integrate_detail::stepAxis<s, o>(m, by, bvy, ay + base);
+      } else {
+        integrate_detail::moveAxis<o>(m, bx, bvx);
+        integrate_detail::moveAxis<o>(m, by, bvy);
+      }
+      for (size_t i = 0; i < m; ++i)
+        inside[i] = bounds.contains(bx[i], by[i]);
+      for (size_t i = 0; i < m; ++i) {
+        survivors[count] = (uint32_t) (base + i);
+        count += inside[i];
+      }
+    }
+    return count;
+  }
+}
+
+#endif // KOZET_FIXED_POINT_KFP_INTEGRATE_H
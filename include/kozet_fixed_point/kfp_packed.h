@@ -0,0 +1,154 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#ifndef KOZET_FIXED_POINT_KFP_PACKED_H
+#define KOZET_FIXED_POINT_KFP_PACKED_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <type_traits>
+
+#include "./kfp.h"
+
+namespace kfp {
+  // Compact storage: values are kept in a narrow type (such as s8_8 or
+  // frac16) and converted to a wide type (such as s16_16 or frac32) for
+  // computation.
+  //
+  // Widening is always exact. Narrowing drops fractional bits according to
+  // a Rounding and handles values out of range according to an Overflow.
+  // For angles, use Overflow::wrap so that values close to a full turn
+  // round to 0 instead of saturating.
+  //
+  // The batch loops are written without branches so that the compiler can
+  // vectorise them.
+
+  // How to drop fractional bits when narrowing.
+  enum class Rounding {
+    // Round towards negative infinity.
+    floor,
+    // Round to nearest, with ties rounded up.
+    nearest,
+  };
+
+  namespace packed_detail {
+    template<typename Narrow, typename Wide>
+    struct Check {
+      using IN = typename Narrow::Underlying;
+      using IW = typename Wide::Underlying;
+      static_assert(
+        std::is_signed<IN>::value == std::is_signed<IW>::value,
+        "Narrow and wide types must have the same signedness");
+      static_assert(sizeof(IN) <= sizeof(IW),
+        "Narrow type must not be larger than the wide type");
+      static_assert(Narrow::fractionalBits() <= Wide::fractionalBits(),
+        "Narrow type must not have more fractional bits than the wide type");
+      static_assert(Narrow::integralBits() <= Wide::integralBits(),
+        "Narrow type must not have more integral bits than the wide type");
+      static constexpr int shift =
+        (int) (Wide::fractionalBits() - Narrow::fractionalBits());
+    };
+  }
+
+  // Converts x to the narrow type.
+  template<
+    typename Narrow,
+    Rounding r = Rounding::nearest, Overflow o = Overflow::saturate,
+    typename I, size_t d>
+  constexpr Narrow narrowTo(Fixed<I, d> x) noexcept {
+    using C = packed_detail::Check<Narrow, Fixed<I, d>>;
+    using IN = typename Narrow::Underlying;
+    using UN = std::make_unsigned_t<IN>;
+    constexpr int shift = C::shift;
+    I v = x.underlying;
+    if (shift > 0) {
+      // Two shifts so that shift == 0 does not shift by -1
+      I half = (I) ((v >> (shift > 0 ? shift - 1 : 0)) & 1);
+      v >>= shift;
+      // Cannot overflow, since v has just lost at least one bit
+      if (r == Rounding::nearest) v += half;
+    }
+    if (o == Overflow::wrap) return Narrow::raw((IN) (UN) v);
+    constexpr I lo = std::numeric_limits<IN>::min();
+    constexpr I hi = std::numeric_limits<IN>::max();
+    v = v < lo ? lo : v;
+    v = v > hi ? hi : v;
+    return Narrow::raw((IN) v);
+  }
+
+  // Converts x to the wide type. This is always exact.
+  template<typename Wide, typename I, size_t d>
+  constexpr Wide widen(Fixed<I, d> x) noexcept {
+    using C = packed_detail::Check<Fixed<I, d>, Wide>;
+    using IW = typename Wide::Underlying;
+    using UW = std::make_unsigned_t<IW>;
+    return Wide::raw((IW) ((UW) (IW) x.underlying << C::shift));
+  }
+
+  // Batch versions of widen() and narrowTo().
+  template<typename Wide, typename Narrow>
+  void widenArray(size_t n, const Narrow* src, Wide* dst) noexcept {
+    for (size_t i = 0; i < n; ++i) dst[i] = widen<Wide>(src[i]);
+  }
+  template<
+    Rounding r = Rounding::nearest, Overflow o = Overflow::saturate,
+    typename Narrow, typename Wide>
+  void narrowArray(size_t n, const Wide* src, Narrow* dst) noexcept {
+    for (size_t i = 0; i < n; ++i) dst[i] = narrowTo<Narrow, r, o>(src[i]);
+  }
+
+  // A view of an array of Narrow values that are read and written as Wide.
+  // Does not own the array.
+  template<
+    typename Narrow, typename Wide,
+    Rounding r = Rounding::nearest, Overflow o = Overflow::saturate>
+  class PackedArrayView {
+  public:
+    constexpr PackedArrayView(Narrow* data, size_t n) noexcept :
+      p(data), n(n) {}
+    constexpr size_t size() const noexcept { return n; }
+    constexpr Narrow* data() const noexcept { return p; }
+    constexpr Wide load(size_t i) const noexcept {
+      return widen<Wide>(p[i]);
+    }
+    void store(size_t i, Wide x) const noexcept {
+      p[i] = narrowTo<Narrow, r, o>(x);
+    }
+    // Loads or stores count elements starting at index first.
+    void load(size_t first, size_t count, Wide* out) const noexcept {
+      widenArray(count, p + first, out);
+    }
+    void store(size_t first, size_t count, const Wide* in) const noexcept {
+      narrowArray<r, o>(count, in, p + first);
+    }
+  private:
+    Narrow* p;
+    size_t n;
+  };
+
+  // Views for the common cases
+  using PackedAngles =
+    PackedArrayView<frac16, frac32, Rounding::nearest, Overflow::wrap>;
+  using PackedS8_8 = PackedArrayView<s8_8, s16_16>;
+  using PackedS2_14 = PackedArrayView<s2_14, s2_30>;
+}
+
+#endif // KOZET_FIXED_POINT_KFP_PACKED_H
@@ -21,7 +21,7 @@
 
 #include "./kfp.h"
 
-#include <iostream>
+#include <iosfwd>
 #include <random>
 
 namespace kfp {
@@ -77,10 +77,12 @@ namespace kfp {
     using I = typename T::Underlying;
     param_type params;
   };
+  // Only <iosfwd> is included; these work as long as the caller includes
+  // <ostream> or <istream>.
   template<typename T>
   std::ostream& operator<<(
       std::ostream& fh, UniformFixedDistribution<T> dist) {
-    fh << dist.a() << " " << dist.b();
+    fh << dist.a() << ' ' << dist.b();
     return fh;
   }
   template<typename T>
@@ -0,0 +1,172 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#ifndef KOZET_FIXED_POINT_KFP_SPATIAL_H
+#define KOZET_FIXED_POINT_KFP_SPATIAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "./kfp.h"
+#include "./kfp_extra.h"
+
+namespace kfp {
+  // A uniform grid used as a broadphase for circle-circle collisions.
+  // Cells are squares of 2**cellShift units of the underlying type
+  // (e. g. cellShift = 21 for 32-unit cells with s16_16), and cell
+  // coordinates are computed by shifting the underlying value directly.
+  // Entities outside of the grid are clamped into the border cells, so
+  // nothing is ever missed; they only cost more narrowphase tests.
+  //
+  // Usage per frame: clear(), insert() every entity, build(), then
+  // query() or forEachPair(). Entities in the same cell are visited in
+  // insertion order, and cells are visited in row-major order, so the
+  // results depend only on the inputs.
+  template<typename F>
+  class SpatialGrid {
+  public:
+    using I = typename F::Underlying;
+    // origin = lower corner of the grid (rounded down to a cell boundary)
+    // width, height = number of cells in each direction
+    SpatialGrid(F originX, F originY,
+        size_t width, size_t height, unsigned cellShift) :
+      width(width), height(height), cellShift(cellShift),
+      originCX(originX.underlying >> cellShift),
+      originCY(originY.underlying >> cellShift),
+      cellStart(width * height + 1) {}
+    void clear() {
+      ids.clear(); xs.clear(); ys.clear(); rs.clear(); cells.clear();
+      maxRadius = F(0);
+    }
+    void reserve(size_t n) {
+      ids.reserve(n); xs.reserve(n); ys.reserve(n);
+      rs.reserve(n); cells.reserve(n);
+    }
+    // Adds an entity with a given ID, centre and radius.
+    // Takes effect on the next call to build().
+    void insert(uint32_t id, F x, F y, F r) {
+      ids.push_back(id);
+      xs.push_back(x);
+      ys.push_back(y);
+      rs.push_back(r);
+      cells.push_back(cellOf(x, y));
+      if (r > maxRadius) maxRadius = r;
+    }
+    // Sorts the inserted entities by cell using a stable counting sort.
+    void build() {
+      size_t n = ids.size();
+      size_t nCells = width * height;
+      std::fill(cellStart.begin(), cellStart.end(), 0);
+      for (size_t i = 0; i < n; ++i) ++cellStart[cells[i] + 1];
+      for (size_t c = 0; c < nCells; ++c) cellStart[c + 1] += cellStart[c];
+      sortedIds.resize(n);
+      sortedXs.resize(n);
+      sortedYs.resize(n);
+      sortedRs.resize(n);
+      // Scatter; cursor[c] starts as cellStart[c] and is advanced in place
+      cursor.assign(cellStart.begin(), cellStart.end() - 1);
+      for (size_t i = 0; i < n; ++i) {
+        size_t j = cursor[cells[i]]++;
+        sortedIds[j] = ids[i];
+        sortedXs[j] = xs[i];
+        sortedYs[j] = ys[i];
+        sortedRs[j] = rs[i];
+      }
+    }
+    size_t size() const { return sortedIds.size(); }
+    // Calls f(id) for every built entity that overlaps the circle
+    // centred at (x, y) with radius r.
+    template<typename Fn>
+    void query(F x, F y, F r, Fn&& f) const {
+      size_t cx0, cy0, cx1, cy1;
+      cellRange(x, y, r, cx0, cy0, cx1, cy1);
+      for (size_t cy = cy0; cy <= cy1; ++cy) {
+        for (size_t cx = cx0; cx <= cx1; ++cx) {
+          size_t c = cy * width + cx;
+          for (size_t j = cellStart[c]; j < cellStart[c + 1]; ++j) {
+            if (isInterior(sortedXs[j] - x, sortedYs[j] - y, sortedRs[j] + r))
+              f(sortedIds[j]);
+          }
+        }
+      }
+    }
+    // Calls f(id1, id2) once for every overlapping pair of built entities.
+    // id1 is the entity that comes first in cell order.
+    template<typename Fn>
+    void forEachPair(Fn&& f) const {
+      size_t n = sortedIds.size();
+      for (size_t i = 0; i < n; ++i) {
+        F x = sortedXs[i], y = sortedYs[i], r = sortedRs[i];
+        size_t cx0, cy0, cx1, cy1;
+        cellRange(x, y, r, cx0, cy0, cx1, cy1);
+        for (size_t cy = cy0; cy <= cy1; ++cy) {
+          for (size_t cx = cx0; cx <= cx1; ++cx) {
+            size_t c = cy * width + cx;
+            size_t j = cellStart[c];
+            if (j <= i) j = i + 1;
+            for (; j < cellStart[c + 1]; ++j) {
+              if (isInterior(sortedXs[j] - x, sortedYs[j] - y, sortedRs[j] + r))
+                f(sortedIds[i], sortedIds[j]);
+            }
+          }
+        }
+      }
+    }
+  private:
+    size_t width, height;
+    unsigned cellShift;
+    I originCX, originCY;
+    F maxRadius = F(0);
+    // Entities in insertion order
+    std::vector<uint32_t> ids;
+    std::vector<F> xs, ys, rs;
+    std::vector<size_t> cells;
+    // Entities sorted by cell; those in cell c are at indices
+    // [cellStart[c], cellStart[c + 1]).
+    std::vector<size_t> cellStart, cursor;
+    std::vector<uint32_t> sortedIds;
+    std::vector<F> sortedXs, sortedYs, sortedRs;
+    // Wide enough to hold a coördinate plus or minus a reach
+    using D = DoubleType<std::make_signed_t<I>>;
+    size_t clampCoord(D v, I origin, size_t n) const noexcept {
+      v >>= cellShift;
+      if (v <= (D) origin) return 0;
+      D off = v - (D) origin;
+      return (off >= (D) n) ? n - 1 : (size_t) off;
+    }
+    size_t cellOf(F x, F y) const noexcept {
+      return clampCoord(y.underlying, originCY, height) * width +
+        clampCoord(x.underlying, originCX, width);
+    }
+    // Cells that may contain entities overlapping the circle at (x, y)
+    // with radius r. Computed in D so that nothing can overflow.
+    void cellRange(F x, F y, F radius,
+        size_t& cx0, size_t& cy0, size_t& cx1, size_t& cy1) const noexcept {
+      D r = (D) radius.underlying + (D) maxRadius.underlying;
+      cx0 = clampCoord((D) x.underlying - r, originCX, width);
+      cy0 = clampCoord((D) y.underlying - r, originCY, height);
+      cx1 = clampCoord((D) x.underlying + r, originCX, width);
+      cy1 = clampCoord((D) y.underlying + r, originCY, height);
+    }
+  };
+}
+
+#endif // KOZET_FIXED_POINT_KFP_SPATIAL_H
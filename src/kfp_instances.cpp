@@ -0,0 +1,63 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Definitions of the functions declared in kfp_instances.h.
+#include "kozet_fixed_point/kfp_instances.h"
+#include "kozet_fixed_point/kfp_extra.h"
+
+namespace kfp {
+  namespace lib {
+    void sincos(frac32 t, s2_30& c, s2_30& s) noexcept {
+      kfp::sincos(t, c, s);
+    }
+    void sincos(frac16 t, s2_14& c, s2_14& s) noexcept {
+      kfp::sincos(t, c, s);
+    }
+
+#define KFP_LIB_DEFINE(F) \
+    void rectp(F c, F s, F& r, frac32& t) noexcept { \
+      kfp::rectp(c, s, r, t); \
+    } \
+    frac32 atan2(F y, F x) noexcept { return kfp::atan2(y, x); } \
+    bool isInterior(F x, F y, F r) noexcept { \
+      return kfp::isInterior(x, y, r); \
+    } \
+    DoubleType<F> magnitude2(F x, F y) noexcept { \
+      return kfp::magnitude2(x, y); \
+    } \
+    bool isWithinDistance(F x1, F y1, F x2, F y2, F r) noexcept { \
+      return kfp::isWithinDistance(x1, y1, x2, y2, r); \
+    } \
+    F hypot(F x, F y) noexcept { return kfp::hypot(x, y); }
+    KFP_LIB_DEFINE(s16_16)
+    KFP_LIB_DEFINE(s2_30)
+    KFP_LIB_DEFINE(s34_30)
+#undef KFP_LIB_DEFINE
+
+    bool segmentIntersectsCircle(
+        s16_16 x1, s16_16 y1, s16_16 x2, s16_16 y2,
+        s16_16 cx, s16_16 cy, s16_16 r) noexcept {
+      return kfp::segmentIntersectsCircle(x1, y1, x2, y2, cx, cy, r);
+    }
+    bool segmentsIntersect(
+        s16_16 ax1, s16_16 ay1, s16_16 ax2, s16_16 ay2,
+        s16_16 bx1, s16_16 by1, s16_16 bx2, s16_16 by2) noexcept {
+      return kfp::segmentsIntersect(ax1, ay1, ax2, ay2, bx1, by1, bx2, by2);
+    }
+    int32_t sqrti(int32_t n) noexcept { return kfp::sqrti(n); }
+    int64_t sqrti(int64_t n) noexcept { return kfp::sqrti(n); }
+  }
+}
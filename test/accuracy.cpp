@@ -0,0 +1,318 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Exhaustive accuracy and speed checks for the trigonometric and square
+// root kernels, run over the whole 32-bit input domain on all cores.
+//
+// Usage: accuracy [stride [threads]]
+// With a stride of k, only every k-th input is checked (use this for quick
+// runs). The default is 1, i. e. every input.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "kozet_fixed_point/kfp.h"
+#include "kozet_fixed_point/kfp_extra.h"
+
+using kfp::frac16;
+using kfp::frac32;
+using kfp::s2_14;
+using kfp::s2_30;
+using kfp::s16_16;
+
+static const long double TAU = 6.283185307179586476925286766559L;
+static const long double TWO32 = 4294967296.0L;
+
+// Absolute errors (in units in the last place of the output) and the
+// number of results that differ from another implementation.
+struct Stats {
+  long double maxError = 0;
+  long double sumError = 0;
+  uint64_t count = 0;
+  uint64_t mismatches = 0;
+  void add(long double e) {
+    e = fabsl(e);
+    if (e > maxError) maxError = e;
+    sumError += e;
+    ++count;
+  }
+  void merge(const Stats& other) {
+    if (other.maxError > maxError) maxError = other.maxError;
+    sumError += other.sumError;
+    count += other.count;
+    mismatches += other.mismatches;
+  }
+};
+
+std::ostream& operator<<(std::ostream& fh, const Stats& s) {
+  return fh << "max " << (double) s.maxError << " ulp, mean " <<
+    (double) (s.count != 0 ? s.sumError / s.count : 0) << " ulp";
+}
+
+// Calls f(first, last, t) on each of the threads, where [first, last) is
+// that thread's share of the sample indices 0, 1, ... ceil(domain / stride).
+template<typename Func>
+void parallelFor(uint64_t domain, uint64_t stride, unsigned threads, Func f) {
+  uint64_t samples = (domain + stride - 1) / stride;
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    uint64_t first = samples * t / threads;
+    uint64_t last = samples * (t + 1) / threads;
+    workers.emplace_back(f, first, last, t);
+  }
+  for (std::thread& w : workers) w.join();
+}
+
+// Runs check(i, stats) on every stride-th input in [0, domain).
+template<typename Check>
+std::vector<Stats> sweep(
+    uint64_t domain, uint64_t stride, unsigned threads,
+    size_t nStats, Check check) {
+  std::vector<std::vector<Stats>> partial(
+    threads, std::vector<Stats>(nStats));
+  parallelFor(domain, stride, threads,
+    [&](uint64_t first, uint64_t last, unsigned t) {
+      std::vector<Stats>& stats = partial[t];
+      for (uint64_t k = first; k < last; ++k) check(k * stride, stats.data());
+    });
+  std::vector<Stats> total(nStats);
+  for (const std::vector<Stats>& p : partial) {
+    for (size_t j = 0; j < nStats; ++j) total[j].merge(p[j]);
+  }
+  return total;
+}
+
+// Timings do not need every input, so they use a stride at least this
+// large (a prime, so that it does not line up with powers of two).
+static const uint64_t MIN_TIMING_STRIDE = 61;
+
+// Average CPU time per call of kernel(i) on each thread, in nanoseconds.
+template<typename Kernel>
+double nsPerOp(
+    uint64_t domain, uint64_t stride, unsigned threads, Kernel kernel) {
+  if (domain >= (1ULL << 32) && stride < MIN_TIMING_STRIDE)
+    stride = MIN_TIMING_STRIDE;
+  std::vector<double> seconds(threads);
+  std::vector<uint64_t> sinks(threads);
+  parallelFor(domain, stride, threads,
+    [&](uint64_t first, uint64_t last, unsigned t) {
+      auto start = std::chrono::steady_clock::now();
+      uint64_t sink = 0;
+      for (uint64_t k = first; k < last; ++k) sink += kernel(k * stride);
+      auto end = std::chrono::steady_clock::now();
+      seconds[t] = std::chrono::duration<double>(end - start).count();
+      sinks[t] = sink;
+    });
+  double total = 0;
+  uint64_t sink = 0;
+  for (unsigned t = 0; t < threads; ++t) {
+    total += seconds[t];
+    sink += sinks[t];
+  }
+  // Keep the results alive without printing them on every line
+  if (sink == 0x5555'5555'5555'5555) std::cout << "";
+  uint64_t samples = (domain + stride - 1) / stride;
+  return total / samples * 1e9;
+}
+
+void printMismatches(const char* what, const Stats& s) {
+  std::cout << "  " << what << ": " <<
+    (s.mismatches == 0 ? "bit-identical" : "DIFFERENT") << " (" <<
+    s.mismatches << " mismatches in " << s.count << " inputs)\n";
+}
+
+void checkSincos(uint64_t stride, unsigned threads) {
+  std::cout << "sincos(frac32), " << TWO32 / stride << " angles\n";
+  std::vector<Stats> stats = sweep(1ULL << 32, stride, threads, 2,
+    [](uint64_t i, Stats* st) {
+      s2_30 c, s;
+      kfp::sincos(frac32::raw((uint32_t) i), c, s);
+      long double a = TAU * i / TWO32;
+      st[0].add(c.underlying - cosl(a) * (1 << 30));
+      st[1].add(s.underlying - sinl(a) * (1 << 30));
+    });
+  double ns = nsPerOp(1ULL << 32, stride, threads, [](uint64_t i) {
+    s2_30 c, s;
+    kfp::sincos(frac32::raw((uint32_t) i), c, s);
+    return (uint64_t) (c.underlying ^ s.underlying);
+  });
+  std::cout << "  cos: " << stats[0] << "\n";
+  std::cout << "  sin: " << stats[1] << "\n";
+  std::cout << "  " << ns << " ns/op\n";
+}
+
+void checkSincos16(unsigned threads) {
+  // The domain is small, so always check every input
+  std::cout << "sincos(frac16), 65536 angles\n";
+  std::vector<Stats> stats = sweep(1 << 16, 1, threads, 3,
+    [](uint64_t i, Stats* st) {
+      s2_14 c, s;
+      s2_30 c30, s30;
+      kfp::sincos(frac16::raw((uint16_t) i), c, s);
+      kfp::sincos(frac32(frac16::raw((uint16_t) i)), c30, s30);
+      long double a = TAU * i / 65536;
+      st[0].add(c.underlying - cosl(a) * (1 << 14));
+      st[1].add(s.underlying - sinl(a) * (1 << 14));
+      // Compare against the rounded 32-bit result
+      int32_t rc = (int32_t) (((int64_t) c30.underlying + (1 << 15)) >> 16);
+      int32_t rs = (int32_t) (((int64_t) s30.underlying + (1 << 15)) >> 16);
+      st[2].add(0);
+      st[2].mismatches += (c.underlying != rc) | (s.underlying != rs);
+    });
+  double ns = nsPerOp(1 << 16, 1, threads, [](uint64_t i) {
+    s2_14 c, s;
+    kfp::sincos(frac16::raw((uint16_t) i), c, s);
+    return (uint64_t) (uint16_t) (c.underlying ^ s.underlying);
+  });
+  std::cout << "  cos: " << stats[0] << "\n";
+  std::cout << "  sin: " << stats[1] << "\n";
+  std::cout << "  Differs from rounded sincos(frac32) in " <<
+    stats[2].mismatches << " of " << stats[2].count << " inputs\n";
+  std::cout << "  " << ns << " ns/op\n";
+}
+
+// Inputs for rectp() and atan2(): points on circles with radii 2**e for
+// e = MIN_RADIUS_EXP, ... MAX_RADIUS_EXP. Small radii show the effect of
+// the limited resolution of s16_16 on the angle; large radii get close to
+// the overflow limit.
+static const int MIN_RADIUS_EXP = -8;
+static const int MAX_RADIUS_EXP = 14;
+static const int N_RADII = MAX_RADIUS_EXP - MIN_RADIUS_EXP + 1;
+
+// Each input gets one angle and one radius. The radius is picked by
+// hashing the input, so that every radius gets an even spread of angles
+// for any stride.
+inline int radiusIndex(uint64_t i) {
+  return (int) (((i * 0x9E37'79B9'7F4A'7C15ULL) >> 32) % N_RADII);
+}
+
+inline void circlePoint(uint64_t i, s16_16& x, s16_16& y) {
+  s2_30 c, s;
+  kfp::sincos(frac32::raw((uint32_t) i), c, s);
+  // 1 is 2**30 in s2_30 and 2**16 in s16_16
+  int shift = 14 - (radiusIndex(i) + MIN_RADIUS_EXP);
+  x = s16_16::raw(c.underlying >> shift);
+  y = s16_16::raw(s.underlying >> shift);
+}
+
+// Difference between two angles in frac32 units, in [-2**31, 2**31).
+inline long double angleError(frac32 t, long double ref) {
+  long double e = t.underlying - ref;
+  return e - TWO32 * floorl(e / TWO32 + 0.5L);
+}
+
+bool checkRectp(uint64_t stride, unsigned threads) {
+  std::cout << "rectp(s16_16) and atan2(s16_16), " << TWO32 / stride <<
+    " points\n";
+  // For each radius: errors in r and t, and atan2() against rectp()
+  std::vector<Stats> stats = sweep(1ULL << 32, stride, threads, 3 * N_RADII,
+    [](uint64_t i, Stats* st) {
+      s16_16 x, y, r;
+      frac32 t;
+      circlePoint(i, x, y);
+      kfp::rectp(x, y, r, t);
+      frac32 t2 = kfp::atan2(y, x);
+      long double lx = x.underlying, ly = y.underlying;
+      Stats* sr = st + 3 * radiusIndex(i);
+      sr[0].add(r.underlying - hypotl(lx, ly));
+      sr[1].add(angleError(t, atan2l(ly, lx) / TAU * TWO32));
+      sr[2].add(0);
+      sr[2].mismatches += t != t2;
+    });
+  double nsRectp = nsPerOp(1ULL << 32, stride, threads, [](uint64_t i) {
+    s16_16 x, y, r;
+    frac32 t;
+    circlePoint(i, x, y);
+    kfp::rectp(x, y, r, t);
+    return (uint64_t) r.underlying ^ t.underlying;
+  });
+  double nsAtan2 = nsPerOp(1ULL << 32, stride, threads, [](uint64_t i) {
+    s16_16 x, y;
+    circlePoint(i, x, y);
+    return (uint64_t) kfp::atan2(y, x).underlying;
+  });
+  double nsInput = nsPerOp(1ULL << 32, stride, threads, [](uint64_t i) {
+    s16_16 x, y;
+    circlePoint(i, x, y);
+    return (uint64_t) (x.underlying ^ y.underlying);
+  });
+  Stats rTotal, tTotal, same;
+  for (int j = 0; j < N_RADII; ++j) {
+    std::cout << "  radius 2**" << (j + MIN_RADIUS_EXP) << ": r " <<
+      stats[3 * j] << "; t " << stats[3 * j + 1] << "\n";
+    rTotal.merge(stats[3 * j]);
+    tTotal.merge(stats[3 * j + 1]);
+    same.merge(stats[3 * j + 2]);
+  }
+  std::cout << "  all radii: r " << rTotal << "; t " << tTotal << "\n";
+  printMismatches("atan2() against rectp()", same);
+  std::cout << "  rectp: " << nsRectp - nsInput << " ns/op, atan2: " <<
+    nsAtan2 - nsInput << " ns/op (excluding " << nsInput <<
+    " ns/op to generate the input)\n";
+  return same.mismatches == 0;
+}
+
+bool checkSqrt(uint64_t stride, unsigned threads) {
+  std::cout << "sqrti(int64_t) and sqrtiFast(int64_t), " << TWO32 / stride <<
+    " inputs in [0, 2**32)\n";
+  std::vector<Stats> stats = sweep(1ULL << 32, stride, threads, 2,
+    [](uint64_t i, Stats* st) {
+      int64_t n = (int64_t) i;
+      int64_t exact = kfp::sqrti(n);
+      int64_t fast = kfp::sqrtiFast(n);
+      st[0].add(exact - floorl(sqrtl((long double) n)));
+      st[1].add(0);
+      st[1].mismatches += exact != fast;
+    });
+  double nsExact = nsPerOp(1ULL << 32, stride, threads, [](uint64_t i) {
+    return (uint64_t) kfp::sqrti((int64_t) i);
+  });
+  double nsFast = nsPerOp(1ULL << 32, stride, threads, [](uint64_t i) {
+    return (uint64_t) kfp::sqrtiFast((int64_t) i);
+  });
+  std::cout << "  sqrti: " << stats[0] << "\n";
+  printMismatches("sqrtiFast() against sqrti()", stats[1]);
+  std::cout << "  sqrti: " << nsExact << " ns/op, sqrtiFast: " <<
+    nsFast << " ns/op\n";
+  return stats[0].maxError == 0 && stats[1].mismatches == 0;
+}
+
+int main(int argc, char** argv) {
+  uint64_t stride = argc > 1 ? strtoull(argv[1], nullptr, 0) : 1;
+  unsigned threads = argc > 2 ?
+    (unsigned) strtoul(argv[2], nullptr, 0) :
+    std::thread::hardware_concurrency();
+  if (stride == 0) stride = 1;
+  if (threads == 0) threads = 1;
+  std::cout << "Using " << threads << " thread(s), stride " << stride << "\n";
+  auto start = std::chrono::steady_clock::now();
+  bool ok = true;
+  checkSincos(stride, threads);
+  checkSincos16(threads);
+  ok &= checkRectp(stride, threads);
+  ok &= checkSqrt(stride, threads);
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "Finished in " <<
+    std::chrono::duration<double>(end - start).count() << " s\n";
+  std::cout << (ok ? "All cross-checks passed\n" : "Cross-checks FAILED\n");
+  return ok ? 0 : 1;
+}
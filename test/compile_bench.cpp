@@ -0,0 +1,89 @@
+/*
+   Copyright 2018 AGC.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// A stand-in for a typical simulation source file, used by
+// `make compile-bench` to measure how long it takes to compile code that
+// uses the library, with and without kfp_instances.h. `make check-lib`
+// also checks that both versions print the same results.
+
+#include <stdio.h>
+
+#ifdef KFP_USE_INSTANCES
+#include "kozet_fixed_point/kfp_instances.h"
+namespace kx = kfp::lib;
+#else
+#include "kozet_fixed_point/kfp.h"
+#include "kozet_fixed_point/kfp_extra.h"
+namespace kx = kfp;
+#endif
+
+struct Bullet {
+  kfp::s16_16 x, y, vx, vy, r;
+  kfp::frac32 angle;
+};
+
+void fire(Bullet& b, kfp::s16_16 x, kfp::s16_16 y,
+    kfp::frac32 angle, kfp::s16_16 speed) {
+  kfp::s2_30 c, s;
+  kx::sincos(angle, c, s);
+  b.x = x;
+  b.y = y;
+  b.vx = (kfp::s16_16) c * speed;
+  b.vy = (kfp::s16_16) s * speed;
+  b.angle = angle;
+}
+
+kfp::frac32 aim(const Bullet& b, kfp::s16_16 px, kfp::s16_16 py) {
+  return kx::atan2(py - b.y, px - b.x);
+}
+
+bool update(Bullet& b, kfp::s16_16 px, kfp::s16_16 py, kfp::s16_16 pr) {
+  b.x += b.vx;
+  b.y += b.vy;
+  kfp::s16_16 r;
+  kfp::frac32 t;
+  kx::rectp(b.vx, b.vy, r, t);
+  b.angle = t;
+  return kx::isInterior(b.x - px, b.y - py, b.r + pr) ||
+    kx::isWithinDistance(b.x, b.y, px, py, pr) ||
+    kx::hypot(b.x - px, b.y - py) < pr;
+}
+
+bool laser(kfp::s16_16 x1, kfp::s16_16 y1, kfp::s16_16 x2, kfp::s16_16 y2,
+    const Bullet& b) {
+  return kx::segmentIntersectsCircle(x1, y1, x2, y2, b.x, b.y, b.r) ||
+    kx::segmentsIntersect(x1, y1, x2, y2, b.x, b.y, b.x + b.vx, b.y + b.vy);
+}
+
+kfp::s34_30 energy(const Bullet& b) {
+  kfp::s34_30 vx = b.vx, vy = b.vy;
+  kfp::s2_30 c, s;
+  kx::sincos(b.angle, c, s);
+  kfp::s2_30 r;
+  kfp::frac32 t;
+  kx::rectp(c, s, r, t);
+  return vx * vx + vy * vy + (kfp::s34_30) r;
+}
+
+int main() {
+  Bullet b = {};
+  b.r = 2;
+  fire(b, 100, 100, kfp::frac32::raw(0x2000'0000), 3);
+  kfp::frac32 t = aim(b, 200, 50);
+  bool hit = update(b, 110, 110, 5) || laser(0, 0, 200, 200, b);
+  printf("%08x %d %016llx\n", (unsigned) t.underlying, (int) hit,
+    (unsigned long long) energy(b).underlying);
+}
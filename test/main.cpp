@@ -16,15 +16,24 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include <algorithm>
+#include <complex>
 #include <iostream>
 #include <random>
 #include <vector>
 
 #include "kozet_fixed_point/kfp.h"
+#include "kozet_fixed_point/kfp_cache.h"
 #include "kozet_fixed_point/kfp_extra.h"
+#include "kozet_fixed_point/kfp_fft.h"
+#include "kozet_fixed_point/kfp_hash.h"
+#include "kozet_fixed_point/kfp_integrate.h"
+#include "kozet_fixed_point/kfp_packed.h"
 #include "kozet_fixed_point/kfp_random.h"
+#include "kozet_fixed_point/kfp_spatial.h"
 
 void testBasic() {
   using namespace kfp::literals;
@@ -75,6 +84,11 @@ void testTrig() {
   } while (i != kfp::frac32(0));
 }
 
+// Average time per operation between two clock() readings, in nanoseconds.
+double nsPerOp(clock_t start, clock_t end, size_t n) {
+  return ((double) (end - start)) / CLOCKS_PER_SEC / n * 1e9;
+}
+
 void testTrigPerformance() {
   std::cout << "Fixed-point function test: trigonometry performance\n";
 	kfp::s2_30 c, s;
@@ -99,6 +113,186 @@ void testTrigPerformance() {
   std::cout << "(" << (elapsedSec / 0x1000000 * 1e9) << "ns per operation)\n"; 
 }
 
+void testAtan2Performance() {
+  std::cout << "Fixed-point function test: atan2 and distance performance\n";
+  std::vector<kfp::s16_16> cs, ss;
+  kfp::s2_30 c, s;
+  kfp::frac32 i;
+  do {
+    kfp::sincos(i, c, s);
+    cs.push_back((kfp::s16_16) c * 100);
+    ss.push_back((kfp::s16_16) s * 100);
+    i += kfp::frac32::raw(0x1000);
+  } while (i != kfp::frac32(0));
+  size_t n = cs.size();
+  std::vector<kfp::frac32> ts1(n), ts2(n), ts3(n);
+  kfp::s16_16 r;
+  clock_t t1 = clock();
+  for (size_t j = 0; j < n; ++j) kfp::rectp(cs[j], ss[j], r, ts1[j]);
+  clock_t t2 = clock();
+  for (size_t j = 0; j < n; ++j) ts2[j] = kfp::atan2(ss[j], cs[j]);
+  clock_t t3 = clock();
+  for (size_t j = 0; j < n; ++j) ts3[j] = kfp::atan2(ss[j], cs[j], 16);
+  clock_t t4 = clock();
+  size_t inRange1 = 0, inRange2 = 0;
+  kfp::s16_16 cx = 0, cy = 50, range = 75;
+  for (size_t j = 0; j < n; ++j)
+    inRange1 += kfp::hypot(cs[j] - cx, ss[j] - cy) <= range;
+  clock_t t5 = clock();
+  for (size_t j = 0; j < n; ++j)
+    inRange2 += kfp::isWithinDistance(cs[j], ss[j], cx, cy, range);
+  clock_t t6 = clock();
+  std::cout << "atan2 matches rectp: " << (ts1 == ts2) << "\n";
+  int32_t maxError = 0;
+  for (size_t j = 0; j < n; ++j) {
+    int32_t e = (int32_t) (ts3[j].underlying - ts1[j].underlying);
+    maxError = std::max(maxError, std::abs(e));
+  }
+  std::cout << "atan2 (16 iterations) max difference: " <<
+    kfp::frac32::raw(maxError) << " turns\n";
+  std::cout << inRange1 << " in range using hypot; " << inRange2 <<
+    " using isWithinDistance\n";
+  std::cout << "rectp: " << nsPerOp(t1, t2, n) << "ns per operation\n";
+  std::cout << "atan2: " << nsPerOp(t2, t3, n) << "ns per operation\n";
+  std::cout << "atan2 (16 iterations): " << nsPerOp(t3, t4, n) <<
+    "ns per operation\n";
+  std::cout << "hypot(...) <= r: " << nsPerOp(t4, t5, n) <<
+    "ns per operation\n";
+  std::cout << "isWithinDistance: " << nsPerOp(t5, t6, n) <<
+    "ns per operation\n";
+}
+
+void testSegments() {
+  std::cout << "Testing segment predicates\n";
+  using kfp::s16_16;
+  std::mt19937_64 gen;
+  gen.seed(time(nullptr));
+  kfp::UniformFixedDistribution<s16_16> posDist(0, 640);
+  kfp::UniformFixedDistribution<s16_16> radDist(1, 16);
+  const size_t n = 100000;
+  std::vector<s16_16> xs(n), ys(n), rs(n), x2s(n), y2s(n);
+  for (size_t i = 0; i < n; ++i) {
+    xs[i] = posDist(gen); ys[i] = posDist(gen); rs[i] = radDist(gen);
+    x2s[i] = posDist(gen); y2s[i] = posDist(gen);
+  }
+  s16_16 lx1 = 20, ly1 = 30, lx2 = 600, ly2 = 500, width = 8;
+  // Reference implementations in floating point
+  auto distToSegment = [&](double px, double py) {
+    double dx = lx2.toDouble() - lx1.toDouble();
+    double dy = ly2.toDouble() - ly1.toDouble();
+    double t = ((px - lx1.toDouble()) * dx + (py - ly1.toDouble()) * dy) /
+      (dx * dx + dy * dy);
+    t = std::min(1.0, std::max(0.0, t));
+    return std::hypot(px - lx1.toDouble() - t * dx,
+      py - ly1.toDouble() - t * dy);
+  };
+  auto cross = [](double ax, double ay, double bx, double by,
+      double cx, double cy) {
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+  };
+  std::vector<uint32_t> circleMask((n + 31) / 32), capsuleMask((n + 31) / 32),
+    segmentMask((n + 31) / 32);
+  clock_t t1 = clock();
+  kfp::segmentIntersectsCircles(lx1, ly1, lx2, ly2, n,
+    xs.data(), ys.data(), rs.data(), circleMask.data());
+  clock_t t2 = clock();
+  kfp::pointsInCapsule(lx1, ly1, lx2, ly2, width, n,
+    xs.data(), ys.data(), capsuleMask.data());
+  clock_t t3 = clock();
+  kfp::segmentIntersectsSegments(lx1, ly1, lx2, ly2, n,
+    xs.data(), ys.data(), x2s.data(), y2s.data(), segmentMask.data());
+  clock_t t4 = clock();
+  size_t mismatches = 0, hits = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double px = xs[i].toDouble(), py = ys[i].toDouble();
+    double dist = distToSegment(px, py);
+    bool circle = (circleMask[i / 32] >> (i % 32)) & 1;
+    bool capsule = (capsuleMask[i / 32] >> (i % 32)) & 1;
+    bool segment = (segmentMask[i / 32] >> (i % 32)) & 1;
+    double o1 = cross(lx1.toDouble(), ly1.toDouble(),
+      lx2.toDouble(), ly2.toDouble(), px, py);
+    double o2 = cross(lx1.toDouble(), ly1.toDouble(),
+      lx2.toDouble(), ly2.toDouble(), x2s[i].toDouble(), y2s[i].toDouble());
+    double o3 = cross(px, py, x2s[i].toDouble(), y2s[i].toDouble(),
+      lx1.toDouble(), ly1.toDouble());
+    double o4 = cross(px, py, x2s[i].toDouble(), y2s[i].toDouble(),
+      lx2.toDouble(), ly2.toDouble());
+    mismatches += (circle != (dist <= rs[i].toDouble())) +
+      (capsule != (dist <= width.toDouble())) +
+      (segment != (o1 * o2 < 0 && o3 * o4 < 0)) +
+      (circle != kfp::segmentIntersectsCircle(
+        lx1, ly1, lx2, ly2, xs[i], ys[i], rs[i]));
+    hits += circle + capsule + segment;
+  }
+  std::cout << mismatches << " mismatches; " << hits << " hits\n";
+  // Touching exactly at the boundary counts as intersecting
+  s16_16 e = s16_16::raw(1);
+  bool boundary =
+    kfp::segmentIntersectsCircle(lx1, ly1, lx2, ly2, lx2 + width, ly2, width) &&
+    !kfp::segmentIntersectsCircle(lx1, ly1, lx2, ly2,
+      lx2 + width + e, ly2, width) &&
+    kfp::isInCapsule(s16_16(0), s16_16(3), s16_16(-5), s16_16(0),
+      s16_16(5), s16_16(0), s16_16(3)) &&
+    !kfp::isInCapsule(s16_16(0), s16_16(3) + e, s16_16(-5), s16_16(0),
+      s16_16(5), s16_16(0), s16_16(3)) &&
+    kfp::segmentsIntersect(s16_16(0), s16_16(0), s16_16(2), s16_16(2),
+      s16_16(2), s16_16(2), s16_16(4), s16_16(0));
+  std::cout << "Boundary cases: " << boundary << "\n";
+  std::cout << "segmentIntersectsCircles: " << nsPerOp(t1, t2, n) <<
+    "ns per test\n";
+  std::cout << "pointsInCapsule: " << nsPerOp(t2, t3, n) << "ns per test\n";
+  std::cout << "segmentIntersectsSegments: " << nsPerOp(t3, t4, n) <<
+    "ns per test\n";
+}
+
+void testTrigCache() {
+  std::cout << "Testing sincos/rectp cache\n";
+  // A 32-way ring whose base angle changes every 64 frames
+  std::vector<kfp::frac32> angles;
+  for (uint32_t frame = 0; frame < 1024; ++frame) {
+    for (uint32_t j = 0; j < 32; ++j) {
+      for (int bullet = 0; bullet < 32; ++bullet)
+        angles.push_back(kfp::frac32::raw(
+          (frame / 64) * 0x0123'4567u + (j << 27)));
+    }
+  }
+  kfp::SincosCache<> cache;
+  kfp::RectpCache<kfp::s16_16> rcache;
+  kfp::s2_30 c, s, c2, s2;
+  kfp::s16_16 r, r2;
+  kfp::frac32 t, tc;
+  size_t mismatches = 0;
+  for (kfp::frac32 a : angles) {
+    kfp::sincos(a, c, s);
+    cache.sincos(a, c2, s2);
+    kfp::rectp((kfp::s16_16) c, (kfp::s16_16) s, r, t);
+    rcache.rectp((kfp::s16_16) c, (kfp::s16_16) s, r2, tc);
+    mismatches += c != c2 || s != s2 || r != r2 || t != tc;
+  }
+  std::cout << mismatches << " mismatches\n";
+  std::cout << "sincos: " << cache.hits() << " hits, " << cache.misses() <<
+    " misses\n";
+  std::cout << "rectp: " << rcache.hits() << " hits, " << rcache.misses() <<
+    " misses\n";
+  kfp::s2_30 sink = 0;
+  clock_t t1 = clock();
+  for (kfp::frac32 a : angles) {
+    kfp::sincos(a, c, s);
+    sink += c;
+  }
+  clock_t t2 = clock();
+  for (kfp::frac32 a : angles) {
+    kfp::cachedSincos(a, c, s);
+    sink -= c;
+  }
+  clock_t t3 = clock();
+  std::cout << "sink = " << sink << "\n";
+  std::cout << "sincos: " << nsPerOp(t1, t2, angles.size()) <<
+    "ns per operation\n";
+  std::cout << "cachedSincos: " << nsPerOp(t2, t3, angles.size()) <<
+    "ns per operation\n";
+}
+
 void testSqrtPerformance() {
   std::cout << "Testing sqrt performance\n";
   std::cout << "Using " << (sizeof(int) * CHAR_BIT) << "-bit ints\n";
@@ -137,11 +331,466 @@ void testRandom() {
   std::cout << s << " should be near 1500\n";
 }
 
+void testSpatialGrid() {
+  std::cout << "Testing spatial grid\n";
+  std::mt19937_64 gen;
+  gen.seed(time(nullptr));
+  kfp::UniformFixedDistribution<kfp::s16_16> posDist(-16, 656);
+  kfp::UniformFixedDistribution<kfp::s16_16> radDist(1, 8);
+  std::vector<kfp::s16_16> xs, ys, rs;
+  // 32-unit cells on a 640 * 640 field
+  kfp::SpatialGrid<kfp::s16_16> grid(0, 0, 20, 20, 21);
+  for (uint32_t i = 0; i < 2000; ++i) {
+    xs.push_back(posDist(gen));
+    ys.push_back(posDist(gen));
+    rs.push_back(radDist(gen));
+    grid.insert(i, xs[i], ys[i], rs[i]);
+  }
+  grid.build();
+  using Pair = std::pair<uint32_t, uint32_t>;
+  std::vector<Pair> expectedPairs, pairs;
+  for (uint32_t i = 0; i < xs.size(); ++i) {
+    for (uint32_t j = i + 1; j < xs.size(); ++j) {
+      if (kfp::isInterior(xs[j] - xs[i], ys[j] - ys[i], rs[i] + rs[j]))
+        expectedPairs.push_back({i, j});
+    }
+  }
+  grid.forEachPair([&](uint32_t a, uint32_t b) { pairs.push_back({a, b}); });
+  std::vector<Pair> sortedPairs;
+  for (const Pair& p : pairs)
+    sortedPairs.push_back({std::min(p.first, p.second),
+      std::max(p.first, p.second)});
+  std::sort(sortedPairs.begin(), sortedPairs.end());
+  std::cout << pairs.size() << " pairs found; " << expectedPairs.size() <<
+    " expected; same set: " << (sortedPairs == expectedPairs) << "\n";
+  std::vector<uint32_t> expectedHits, hits;
+  kfp::s16_16 r = 40;
+  for (uint32_t i = 0; i < xs.size(); ++i) {
+    if (kfp::isInterior(xs[i] - 320, ys[i] - 320, rs[i] + r))
+      expectedHits.push_back(i);
+  }
+  grid.query(320, 320, r, [&](uint32_t id) { hits.push_back(id); });
+  std::vector<uint32_t> sortedHits = hits;
+  std::sort(sortedHits.begin(), sortedHits.end());
+  std::cout << hits.size() << " hits found; " << expectedHits.size() <<
+    " expected; same set: " << (sortedHits == expectedHits) << "\n";
+  // Rebuilding with the same insertion order gives the same sequences
+  grid.clear();
+  for (uint32_t i = 0; i < xs.size(); ++i) grid.insert(i, xs[i], ys[i], rs[i]);
+  grid.build();
+  std::vector<Pair> pairs2;
+  std::vector<uint32_t> hits2;
+  grid.forEachPair([&](uint32_t a, uint32_t b) { pairs2.push_back({a, b}); });
+  grid.query(320, 320, r, [&](uint32_t id) { hits2.push_back(id); });
+  std::cout << "Same order after rebuilding: " <<
+    (pairs == pairs2 && hits == hits2) << "\n";
+  // Near the edge of the range of s16_16, x + r must not overflow
+  kfp::s16_16 far = std::numeric_limits<kfp::s16_16>::max() - 4;
+  grid.clear();
+  grid.insert(7, far, far, 2);
+  grid.build();
+  size_t farHits = 0;
+  grid.query(far, far, 8, [&](uint32_t) { ++farHits; });
+  std::cout << "Hits near the edge of the range: " << farHits <<
+    " (expected 1)\n";
+}
+
+void testChecksum() {
+  std::cout << "Testing checksums\n";
+  kfp::StateHasher h;
+  const char* text = "Nobody inspects the spammish repetition";
+  h.update(text, strlen(text));
+  std::cout << std::hex << h.digest() << " should be fbcea83c8a378bf1\n"
+    << std::dec;
+  std::vector<kfp::s16_16> state(1 << 20);
+  for (size_t i = 0; i < state.size(); ++i)
+    state[i] = kfp::s16_16::raw((int32_t) (i * 2654435761u));
+  uint64_t oneShot = kfp::checksum(state.data(), state.size());
+  h.reset();
+  for (size_t i = 0; i < state.size(); i += 77)
+    h.update(state.data() + i, std::min<size_t>(77, state.size() - i));
+  std::cout << "Streaming checksum matches: " << (h.digest() == oneShot)
+    << "\n";
+  kfp::IncrementalChecksum inc1, inc2;
+  inc1.addAll(state.data(), state.size());
+  kfp::s16_16 old = state[1234];
+  state[1234] += 1;
+  inc1.replace(1234, old, state[1234]);
+  inc2.addAll(state.data(), state.size());
+  std::cout << "Incremental checksum matches: "
+    << (inc1.digest() == inc2.digest()) << "\n";
+  uint64_t sink = 0;
+  clock_t t1 = clock();
+  for (int i = 0; i < 100; ++i) {
+    sink += kfp::checksum(state.data(), state.size(), i);
+  }
+  clock_t t2 = clock();
+  std::cout << "sink = " << sink << "\n";
+  double elapsedSec = ((double) (t2 - t1)) / CLOCKS_PER_SEC;
+  std::cout << "Hashing 400 MiB takes " << elapsedSec << "s ("
+    << (400 / elapsedSec) << " MiB/s)\n";
+}
+
+void testInt128() {
+  std::cout << "Testing portable 128-bit integers\n";
+  std::mt19937_64 gen;
+  gen.seed(time(nullptr));
+  std::vector<kfp::Int128> xs, ys;
+  for (size_t i = 0; i < 100000; ++i) {
+    // Mostly products of 64-bit values, as in DoubleType<int64_t>
+    xs.push_back(kfp::Int128((int64_t) gen()) * (int64_t) gen());
+    ys.push_back(kfp::Int128((int64_t) (gen() >> (gen() % 64))) | 1);
+  }
+  size_t mismatches = 0;
+#ifdef __SIZEOF_INT128__
+  auto same = [](kfp::Int128 a, __int128_t b) {
+    return a.lo == (uint64_t) b && a.hi == (uint64_t) (b >> 64);
+  };
+  auto native = [](kfp::Int128 a) {
+    return (__int128_t) (((__uint128_t) a.hi << 64) | a.lo);
+  };
+  // Signed overflow is undefined, so compute the wrapping operations of
+  // kfp::Int128 in __uint128_t
+  auto wrapMul = [](__int128_t a, __int128_t b) {
+    return (__int128_t) ((__uint128_t) a * (__uint128_t) b);
+  };
+  auto wrapShl = [](__int128_t a, int s) {
+    return (__int128_t) ((__uint128_t) a << s);
+  };
+  for (size_t i = 0; i < xs.size(); ++i) {
+    kfp::Int128 x = xs[i], y = ys[i];
+    __int128_t nx = native(x), ny = native(y);
+    int s = (int) (i % 128);
+    mismatches +=
+      !same(x * y, wrapMul(nx, ny)) + !same(x / y, nx / ny) +
+      !same(x % y, nx % ny) + !same(x >> s, nx >> s) +
+      !same(x << s, wrapShl(nx, s)) + ((x < y) != (nx < ny));
+  }
+  // Divisors with a nonzero high word take the 128 / 128 path of divmodU
+  for (size_t i = 0; i < 100000; ++i) {
+    kfp::Int128 x = kfp::Int128::fromParts(gen(), gen());
+    kfp::Int128 y = kfp::Int128::fromParts(gen() >> (gen() % 63 + 1), gen());
+    if (y.hi == 0) y.hi = 1;
+    if (gen() & 1) y = -y;
+    __int128_t nx = native(x), ny = native(y);
+    mismatches += !same(x / y, nx / ny) + !same(x % y, nx % ny);
+    kfp::UInt128 ux = kfp::UInt128::fromParts(x.hi, x.lo);
+    kfp::UInt128 uy = kfp::UInt128::fromParts(y.hi, y.lo);
+    __uint128_t nux = (__uint128_t) nx, nuy = (__uint128_t) ny;
+    kfp::UInt128 uq = ux / uy, ur = ux % uy;
+    mismatches +=
+      (uq.lo != (uint64_t) (nux / nuy)) +
+      (uq.hi != (uint64_t) ((nux / nuy) >> 64)) +
+      (ur.lo != (uint64_t) (nux % nuy)) +
+      (ur.hi != (uint64_t) ((nux % nuy) >> 64));
+  }
+  std::cout << mismatches << " mismatches against __int128\n";
+#endif
+  kfp::Int128 sink = 0;
+  clock_t t1 = clock();
+  for (int j = 0; j < 10; ++j) {
+    for (size_t i = 0; i < xs.size(); ++i) sink += xs[i] * ys[i];
+  }
+  clock_t t2 = clock();
+  for (int j = 0; j < 10; ++j) {
+    for (size_t i = 0; i < xs.size(); ++i) sink += xs[i] / ys[i];
+  }
+  clock_t t3 = clock();
+  std::cout << "sink = " << (double) sink << "\n";
+  std::cout << "kfp::Int128: " <<
+    (((double) (t2 - t1)) / CLOCKS_PER_SEC / 1e6 * 1e9) << "ns per *, " <<
+    (((double) (t3 - t2)) / CLOCKS_PER_SEC / 1e6 * 1e9) << "ns per /\n";
+#ifdef __SIZEOF_INT128__
+  // Unsigned, so that the sums wrap around instead of overflowing
+  __uint128_t nsink = 0;
+  t1 = clock();
+  for (int j = 0; j < 10; ++j) {
+    for (size_t i = 0; i < xs.size(); ++i)
+      nsink += (__uint128_t) native(xs[i]) * (__uint128_t) native(ys[i]);
+  }
+  t2 = clock();
+  for (int j = 0; j < 10; ++j) {
+    for (size_t i = 0; i < xs.size(); ++i)
+      nsink += (__uint128_t) (native(xs[i]) / native(ys[i]));
+  }
+  t3 = clock();
+  std::cout << "sink = " << (double) nsink << "\n";
+  std::cout << "__int128: " <<
+    (((double) (t2 - t1)) / CLOCKS_PER_SEC / 1e6 * 1e9) << "ns per *, " <<
+    (((double) (t3 - t2)) / CLOCKS_PER_SEC / 1e6 * 1e9) << "ns per /\n";
+#endif
+  kfp::s34_30 a = 12345;
+  kfp::s34_30 b = -kfp::s34_30::raw(0x1234'5678);
+  std::cout << a << " * " << b << " = " << (a * b) << "\n";
+  std::cout << a << " / " << b << " = " << (a / b) << "\n";
+}
+
+// Checks integrate() and integrateAndCull() against a scalar reference
+// that does its arithmetic in int64_t, with and without accelerations.
+// The values are large enough for some additions to overflow.
+template<kfp::Scheme sch, kfp::Overflow o>
+bool integrateMatchesReference(std::mt19937_64& gen) {
+  using kfp::s16_16;
+  const size_t n = 1003;
+  kfp::UniformFixedDistribution<s16_16> posDist(-32000, 32000);
+  kfp::UniformFixedDistribution<s16_16> velDist(-2000, 2000);
+  std::vector<s16_16> x0(n), y0(n), vx0(n), vy0(n), ax(n), ay(n);
+  for (size_t i = 0; i < n; ++i) {
+    x0[i] = posDist(gen); y0[i] = posDist(gen);
+    vx0[i] = velDist(gen); vy0[i] = velDist(gen);
+    ax[i] = velDist(gen); ay[i] = velDist(gen);
+  }
+  auto add = [](s16_16 a, s16_16 b) {
+    int64_t r = (int64_t) a.underlying + b.underlying;
+    if (o == kfp::Overflow::wrap)
+      return s16_16::raw((int32_t) (uint32_t) r);
+    r = std::max<int64_t>(r, INT32_MIN);
+    r = std::min<int64_t>(r, INT32_MAX);
+    return s16_16::raw((int32_t) r);
+  };
+  kfp::Bounds<s16_16> bounds = {-16000, -16000, 16000, 16000};
+  bool ok = true;
+  for (int withAccel = 0; withAccel < 2; ++withAccel) {
+    const s16_16* pax = withAccel ? ax.data() : nullptr;
+    const s16_16* pay = withAccel ? ay.data() : nullptr;
+    std::vector<s16_16> rx = x0, ry = y0, rvx = vx0, rvy = vy0;
+    std::vector<uint32_t> expected;
+    for (size_t i = 0; i < n; ++i) {
+      if (withAccel && sch == kfp::Scheme::symplecticEuler) {
+        rvx[i] = add(rvx[i], ax[i]); rvy[i] = add(rvy[i], ay[i]);
+      }
+      rx[i] = add(rx[i], rvx[i]); ry[i] = add(ry[i], rvy[i]);
+      if (withAccel && sch == kfp::Scheme::euler) {
+        rvx[i] = add(rvx[i], ax[i]); rvy[i] = add(rvy[i], ay[i]);
+      }
+      if (bounds.contains(rx[i], ry[i])) expected.push_back((uint32_t) i);
+    }
+    std::vector<s16_16> x = x0, y = y0, vx = vx0, vy = vy0;
+    kfp::integrate<sch, o>(n, x.data(), y.data(), vx.data(), vy.data(),
+      pax, pay);
+    ok &= x == rx && y == ry && vx == rvx && vy == rvy;
+    x = x0; y = y0; vx = vx0; vy = vy0;
+    std::vector<uint32_t> survivors(n);
+    size_t count = kfp::integrateAndCull<sch, o>(n,
+      x.data(), y.data(), vx.data(), vy.data(), pax, pay, bounds,
+      survivors.data());
+    survivors.resize(count);
+    ok &= x == rx && y == ry && vx == rvx && vy == rvy &&
+      survivors == expected;
+  }
+  return ok;
+}
+
+void testIntegrate() {
+  std::cout << "Testing batch integration\n";
+  using kfp::s16_16;
+  std::mt19937_64 gen;
+  gen.seed(time(nullptr));
+  kfp::UniformFixedDistribution<s16_16> posDist(0, 640);
+  kfp::UniformFixedDistribution<s16_16> velDist(-4, 4);
+  kfp::UniformFixedDistribution<s16_16> accDist(s16_16(-1) / 16, s16_16(1) / 16);
+  const size_t n = 1 << 20;
+  std::vector<s16_16> x(n), y(n), vx(n), vy(n), ax(n), ay(n);
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = posDist(gen); y[i] = posDist(gen);
+    vx[i] = velDist(gen); vy[i] = velDist(gen);
+    ax[i] = accDist(gen); ay[i] = accDist(gen);
+  }
+  std::vector<s16_16> rx = x, ry = y, rvx = vx, rvy = vy;
+  kfp::Bounds<s16_16> bounds = {0, 0, 640, 640};
+  std::vector<uint32_t> survivors(n), expected;
+  size_t count = 0;
+  clock_t t1 = clock();
+  for (int frame = 0; frame < 10; ++frame) {
+    count = kfp::integrateAndCull(n, x.data(), y.data(), vx.data(), vy.data(),
+      ax.data(), ay.data(), bounds, survivors.data());
+  }
+  clock_t t2 = clock();
+  for (int frame = 0; frame < 10; ++frame) {
+    expected.clear();
+    for (size_t i = 0; i < n; ++i) {
+      rx[i] += rvx[i]; ry[i] += rvy[i];
+      rvx[i] += ax[i]; rvy[i] += ay[i];
+      if (rx[i] >= 0 && rx[i] <= 640 && ry[i] >= 0 && ry[i] <= 640)
+        expected.push_back((uint32_t) i);
+    }
+  }
+  clock_t t3 = clock();
+  bool same = x == rx && y == ry && vx == rvx && vy == rvy &&
+    count == expected.size() &&
+    std::equal(expected.begin(), expected.end(), survivors.begin());
+  std::cout << "Matches scalar loop: " << same << " (" << count <<
+    " survivors)\n";
+  std::cout << "integrateAndCull: " << nsPerOp(t1, t2, 10 * n) <<
+    "ns per particle\n";
+  std::cout << "Scalar loop: " << nsPerOp(t2, t3, 10 * n) <<
+    "ns per particle\n";
+  s16_16 big = std::numeric_limits<s16_16>::max() - 1;
+  s16_16 sat = kfp::addWith<kfp::Overflow::saturate>(big, s16_16(2));
+  std::cout << "Saturated: " << (sat == std::numeric_limits<s16_16>::max())
+    << "\n";
+  using kfp::Scheme; using kfp::Overflow;
+  std::cout << "All schemes and overflow modes match reference: " <<
+    (integrateMatchesReference<Scheme::euler, Overflow::wrap>(gen) &&
+      integrateMatchesReference<Scheme::euler, Overflow::saturate>(gen) &&
+      integrateMatchesReference<Scheme::symplecticEuler, Overflow::wrap>(gen) &&
+      integrateMatchesReference<Scheme::symplecticEuler, Overflow::saturate>(
+        gen)) << "\n";
+}
+
+void testPacked() {
+  std::cout << "Testing packed storage\n";
+  using kfp::s8_8; using kfp::s16_16;
+  using kfp::s2_14; using kfp::s2_30;
+  using kfp::frac16; using kfp::frac32;
+  using kfp::Rounding; using kfp::Overflow;
+  // 16-bit sincos against the 32-bit version
+  // Also checks that more than CORDIC_ITERATIONS iterations are clamped
+  int maxError = 0;
+  size_t clampMismatches = 0;
+  for (uint32_t i = 0; i < 65536; ++i) {
+    frac16 t = frac16::raw((uint16_t) i);
+    s2_14 c, s;
+    s2_30 c30, s30, c40, s40;
+    kfp::sincos(t, c, s);
+    kfp::sincos(frac32(t), c30, s30);
+    kfp::sincos(frac32(t), c40, s40, kfp::CORDIC_ITERATIONS + 10);
+    clampMismatches += c40 != c30 || s40 != s30;
+    int ec = abs((int) ((int64_t) c.underlying -
+      (((int64_t) c30.underlying + (1 << 15)) >> 16)));
+    int es = abs((int) ((int64_t) s.underlying -
+      (((int64_t) s30.underlying + (1 << 15)) >> 16)));
+    maxError = std::max(maxError, std::max(ec, es));
+  }
+  std::cout << "sincos(frac16): max difference from rounded sincos(frac32) = "
+    << maxError << " ulp\n";
+  std::cout << "sincos with " << (kfp::CORDIC_ITERATIONS + 10) <<
+    " iterations: " << clampMismatches << " mismatches\n";
+  // Round trips
+  bool roundTrip = true;
+  for (uint32_t i = 0; i < 65536; ++i) {
+    s8_8 a = s8_8::raw((int16_t) (uint16_t) i);
+    s2_14 b = s2_14::raw((int16_t) (uint16_t) i);
+    frac16 t = frac16::raw((uint16_t) i);
+    roundTrip &= kfp::narrowTo<s8_8>(kfp::widen<s16_16>(a)) == a;
+    roundTrip &= kfp::narrowTo<s2_14>(kfp::widen<s2_30>(b)) == b;
+    roundTrip &= kfp::narrowTo<frac16>(kfp::widen<frac32>(t)) == t;
+  }
+  std::cout << "Round trips exact: " << roundTrip << "\n";
+  s16_16 x = s16_16::raw(0x180); // 1.5 / 256
+  std::cout << "Rounding: floor = " <<
+    kfp::narrowTo<s8_8, Rounding::floor>(x).underlying << ", nearest = " <<
+    kfp::narrowTo<s8_8, Rounding::nearest>(x).underlying << ", -x nearest = " <<
+    kfp::narrowTo<s8_8>(-x).underlying << "\n";
+  std::cout << "Saturation: " <<
+    (kfp::narrowTo<s8_8>(s16_16(200)) == std::numeric_limits<s8_8>::max()) <<
+    (kfp::narrowTo<s8_8>(s16_16(-200)) == std::numeric_limits<s8_8>::min()) <<
+    "\n";
+  {
+    using namespace kfp::literals;
+    std::cout << "Literals: " << "0.5"_frac16.underlying << " " <<
+      "1.5"_s8_8.underlying << " " << "1.25"_s2_14.underlying << " " <<
+      "0.25"_frac32.underlying << " (expected 32768 384 20480 1073741824)\n";
+  }
+  std::cout << "Wrapping angle: " << kfp::narrowTo<frac16,
+    Rounding::nearest, Overflow::wrap>(frac32::raw(0xFFFFFF00u)).underlying <<
+    "\n";
+  // Throughput of batch conversions
+  const size_t n = 1 << 20;
+  std::vector<s16_16> wide(n), back(n);
+  std::vector<s8_8> narrow(n);
+  std::mt19937 gen;
+  gen.seed(time(nullptr));
+  for (size_t i = 0; i < n; ++i)
+    wide[i] = s16_16::raw((int32_t) gen() >> 9);
+  kfp::PackedS8_8 view(narrow.data(), n);
+  clock_t t1 = clock();
+  for (int j = 0; j < 100; ++j) view.store(j, n - j, wide.data() + j);
+  clock_t t2 = clock();
+  for (int j = 0; j < 100; ++j) view.load(j, n - j, back.data() + j);
+  clock_t t3 = clock();
+  bool close = true;
+  for (size_t i = 0; i < n; ++i) {
+    close &= view.load(i) == back[i];
+    close &= abs(back[i].underlying - wide[i].underlying) <= 0x80;
+  }
+  std::cout << "Batch conversions consistent: " << close << "\n";
+  std::cout << "narrowArray: " << nsPerOp(t1, t2, 100 * n) <<
+    "ns per element\n";
+  std::cout << "widenArray: " << nsPerOp(t2, t3, 100 * n) <<
+    "ns per element\n";
+}
+
+template<typename F, size_t N>
+void testFFTFor(const char* name,
+    kfp::FftScaling scaling = kfp::FftScaling::block, F amplitude = 1) {
+  std::mt19937_64 gen;
+  gen.seed(time(nullptr));
+  kfp::UniformFixedDistribution<F> dist(-amplitude, amplitude);
+  std::vector<kfp::Complex<F>> data(N), orig;
+  for (auto& z : data) {
+    z.re = dist(gen);
+    z.im = dist(gen);
+  }
+  orig = data;
+  int e = kfp::fft<N>(data.data(), scaling);
+  // Compare a few bins against a direct DFT in double precision
+  double maxError = 0;
+  for (size_t k = 0; k < N; k += N / 16 + 1) {
+    std::complex<double> sum = 0;
+    for (size_t j = 0; j < N; ++j) {
+      double angle = -2 * M_PI * (double) ((j * k) % N) / N;
+      sum += std::complex<double>(
+        orig[j].re.toDouble(), orig[j].im.toDouble()) *
+        std::polar(1.0, angle);
+    }
+    std::complex<double> got(
+      ldexp(data[k].re.toDouble(), e), ldexp(data[k].im.toDouble(), e));
+    maxError = std::max(maxError, std::abs(got - sum));
+  }
+  int e2 = kfp::ifft<N>(data.data(), scaling);
+  double maxRoundTripError = 0;
+  for (size_t j = 0; j < N; ++j) {
+    double scale = ldexp(1.0, e + e2) / N;
+    maxRoundTripError = std::max(maxRoundTripError, std::abs(
+      std::complex<double>(data[j].re.toDouble() * scale - orig[j].re.toDouble(),
+        data[j].im.toDouble() * scale - orig[j].im.toDouble())));
+  }
+  clock_t t1 = clock();
+  for (int i = 0; i < 100; ++i) kfp::fft<N>(data.data(), scaling);
+  clock_t t2 = clock();
+  // Errors are relative to the amplitude of the input
+  std::cout << N << "-point FFT over " << name << ": max error " <<
+    maxError / amplitude.toDouble() << ", round-trip error " <<
+    maxRoundTripError / amplitude.toDouble() << ", " <<
+    (((double) (t2 - t1)) / CLOCKS_PER_SEC / 100 * 1e6) <<
+    "us per transform\n";
+}
+
+void testFFT() {
+  std::cout << "Testing FFT\n";
+  testFFTFor<kfp::s16_16, 64>("s16_16");
+  testFFTFor<kfp::s16_16, 4096>("s16_16");
+  testFFTFor<kfp::s2_30, 4096>("s2_30");
+  // Inputs just within the documented bound for perStage
+  testFFTFor<kfp::s16_16, 4096>("s16_16 (per stage, full range)",
+    kfp::FftScaling::perStage, 23170);
+}
+
 int main() {
   testBasic();
   testTrig();
   testTrigPerformance();
+  testAtan2Performance();
+  testSegments();
+  testTrigCache();
   testSqrtPerformance();
   testRandom();
+  testSpatialGrid();
+  testChecksum();
+  testInt128();
+  testIntegrate();
+  testPacked();
+  testFFT();
   return 0;
 }
\ No newline at end of file